@@ -1,12 +1,63 @@
+#include <climits>
+#include <cmath>
 #include "BuiltIns.h"
-#include <cstdio>
+#include "DataRuntime.h"
+#include "OutputRuntime.h"
+#include "ParallelRuntime.h"
 
 double print(double num) {
-    fprintf(stderr, "%f\n", num);
+    __solid_write_double(num);
     return 0;
 }
 
 double printc(double num) {
-    fputc((char) num, stderr);
+    char Character = (char) num;
+    __solid_write(&Character, 1);
     return 0;
+}
+
+double flush() {
+    __solid_flush_output();
+    return 0;
+}
+
+namespace {
+
+// -1 (no file) for numbers out of the range of int and NaN, which can't be converted
+int GetDataFile(double file) {
+    return file >= 0 && file < INT_MAX ? (int) file : -1;
+}
+
+}
+
+double datasize(double file) {
+    return (double) __solid_data_size(GetDataFile(file));
+}
+
+double data(double file, double index) {
+    int File = GetDataFile(file);
+    // NaN outside of the file
+    if (!(index >= 0 && index < (double) __solid_data_size(File)))
+        return NAN;
+    return __solid_data_values(File)[(uint64_t) index];
+}
+
+const std::map<std::string, void *> &GetBuiltIns() {
+    static const std::map<std::string, void *> BuiltIns = {
+            {"print",  (void *) &print},
+            {"printc", (void *) &printc},
+            {"flush",  (void *) &flush},
+            {"datasize", (void *) &datasize},
+            {"data", (void *) &data},
+            // called by the built-ins that have been inlined from the runtime bitcode
+            {"__solid_write", (void *) &__solid_write},
+            {"__solid_write_double", (void *) &__solid_write_double},
+            {"__solid_flush_output", (void *) &__solid_flush_output},
+            {"__solid_data_size", (void *) &__solid_data_size},
+            {"__solid_data_values", (void *) &__solid_data_values},
+            {"__solid_parallel_while", (void *) &__solid_parallel_while},
+            {"__solid_spawn", (void *) &__solid_spawn},
+            {"__solid_sync", (void *) &__solid_sync},
+    };
+    return BuiltIns;
 }
\ No newline at end of file
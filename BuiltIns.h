@@ -1,12 +1,27 @@
 #ifndef SOLID_LANG_BUILTINS_H
 #define SOLID_LANG_BUILTINS_H
 
+#include <map>
+#include <string>
+
 extern "C" {
 
 double print(double num);
 
 double printc(double num);
 
+double flush();
+
+// Number of values in data file `file`
+double datasize(double file);
+
+// Value `index` of data file `file`, NaN if there is none
+double data(double file, double index);
+
 }
 
+// The built-ins by name. Backends define them explicitly: the executable doesn't export them on every platform,
+// and programs linking the static library would drop them otherwise.
+const std::map<std::string, void *> &GetBuiltIns();
+
 #endif
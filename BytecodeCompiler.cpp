@@ -0,0 +1,551 @@
+#include "BytecodeCompiler.h"
+#include "Expression.h"
+#include "MathBuiltIns.h"
+
+// operands are 16 bit
+static const unsigned MaxOperand = UINT16_MAX;
+
+unsigned BytecodeCompiler::AllocateRegister() {
+    unsigned Register = NextRegister++;
+    if (NextRegister > Function->NumRegisters)
+        Function->NumRegisters = NextRegister;
+    return Register;
+}
+
+void BytecodeCompiler::ReleaseRegisters(unsigned Mark) {
+    if (Current < Mark) {
+        NextRegister = Mark;
+        return;
+    }
+
+    MoveCurrentTo(Mark);
+    NextRegister = Mark + 1;
+}
+
+void BytecodeCompiler::MoveCurrentTo(unsigned Register) {
+    if (Current != Register)
+        Emit(Opcode::Move, Register, Current);
+    Current = Register;
+}
+
+unsigned BytecodeCompiler::Emit(Opcode Op, unsigned A, unsigned B, unsigned C) {
+    if (A > MaxOperand || B > MaxOperand || C > MaxOperand || Function->Code.size() > MaxOperand) {
+        if (!Failed)
+            LogError("Function is too large for the VM");
+        return 0;
+    }
+
+    Function->Code.push_back({Op, (uint16_t) A, (uint16_t) B, (uint16_t) C});
+    return Function->Code.size() - 1;
+}
+
+void BytecodeCompiler::PatchJump(unsigned Jump) {
+    if (Failed)
+        return;
+    Function->Code[Jump].B = Function->Code.size();
+}
+
+void BytecodeCompiler::EmitCall(const std::string &Name, unsigned Base, unsigned ArgumentCount) {
+    if (VM.HasFunction(Name)) {
+        Emit(Opcode::Call, Base, VM.GetFunctionIndex(Name), Base);
+    } else if (auto Native = VM.GetNativeIndex(Name, ArgumentCount)) {
+        Emit(Opcode::CallNative, Base, *Native, Base);
+    } else {
+        LogError("Unknown native function");
+    }
+
+    NextRegister = Base;
+    Current = AllocateRegister();
+}
+
+void BytecodeCompiler::Visit(VariableExpression &Expression) {
+    auto Register = RegistersByName.find(Expression.GetName());
+    if (Register == RegistersByName.end()) {
+        LogError("Variable unknown");
+        return;
+    }
+
+    Current = Register->second;
+}
+
+void BytecodeCompiler::Visit(VariableDefinition &Expression) {
+    unsigned Mark = NextRegister;
+    std::vector<std::pair<bool, unsigned>> OriginalRegisters;
+
+    for (auto &Variable: Expression.GetVariables()) {
+        const auto &VariableName = Variable.first;
+
+        unsigned InitializerMark = NextRegister;
+        if (auto *Spawn = dynamic_cast<SpawnExpression *>(Variable.second.get())) {
+            Spawn->GetCall().Accept(*this);
+            ReleaseRegisters(InitializerMark);
+        } else if (Variable.second) {
+            Variable.second->Accept(*this);
+            ReleaseRegisters(InitializerMark);
+            // the initializer may be another variable
+            if (Current < InitializerMark)
+                MoveCurrentTo(AllocateRegister());
+        } else {
+            // use 0
+            Function->Constants.push_back(0.0);
+            Current = AllocateRegister();
+            Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+        }
+
+        auto Original = RegistersByName.find(VariableName);
+        OriginalRegisters.emplace_back(Original != RegistersByName.end(),
+                                       Original != RegistersByName.end() ? Original->second : 0);
+
+        RegistersByName[VariableName] = Current;
+    }
+
+    Expression.GetBody().Accept(*this);
+
+    unsigned n = Expression.GetVariables().size();
+    for (unsigned i = 0; i < n; ++i) {
+        const auto &VariableName = Expression.GetVariables()[i].first;
+        if (OriginalRegisters[i].first) {
+            RegistersByName[VariableName] = OriginalRegisters[i].second;
+        } else {
+            RegistersByName.erase(VariableName);
+        }
+    }
+
+    ReleaseRegisters(Mark);
+}
+
+void BytecodeCompiler::Visit(FunctionCall &Expression) {
+    auto Declaration = FunctionDeclarations.find(Expression.GetName());
+    const MathBuiltIn *Math = GetMathBuiltIn(Expression.GetName());
+    if (Declaration == FunctionDeclarations.end() && !Math) {
+        LogError("Calling unknown function");
+        return;
+    }
+
+    unsigned n = Expression.GetArguments().size();
+    unsigned Arity = Declaration != FunctionDeclarations.end() ? Declaration->second->GetArguments().size()
+                                                                : Math->Arity;
+    if (Arity != n) {
+        LogError("Invalid number of arguments passed to function");
+        return;
+    }
+
+    if (Declaration != FunctionDeclarations.end() && Declaration->second->IsTyped()) {
+        LogError("Typed natives can only be called by compiled code");
+        return;
+    }
+
+    unsigned Base = NextRegister;
+    for (unsigned i = 0; i < n; ++i)
+        AllocateRegister();
+
+    for (unsigned i = 0; i < n; ++i) {
+        Expression.GetArguments()[i]->Accept(*this);
+        MoveCurrentTo(Base + i);
+        NextRegister = Base + n;
+    }
+
+    EmitCall(Expression.GetName(), Base, n);
+}
+
+void BytecodeCompiler::Visit(FunctionDeclaration &Expression) {
+    // natives are resolved when they are called first
+}
+
+void BytecodeCompiler::Visit(FunctionDefinition &Expression) {
+    auto Declaration = Expression.TakeDeclaration();
+    auto Name = Declaration->GetName();
+    auto Arguments = Declaration->GetArguments();
+    FunctionDeclarations[Name] = std::move(Declaration);
+
+    // reserve the function's index, so it can call itself
+    bool Reserved = !VM.HasFunction(Name);
+    VM.GetFunctionIndex(Name);
+
+    Function = std::make_unique<BytecodeFunction>();
+    Function->Name = Name;
+    Function->Arity = Arguments.size();
+
+    RegistersByName.clear();
+    NextRegister = 0;
+    Failed = false;
+
+    for (auto &Argument: Arguments)
+        RegistersByName[Argument] = AllocateRegister();
+
+    Expression.GetImplementation().Accept(*this);
+    Emit(Opcode::Return, Current);
+
+    // like the IR generator, a function with errors isn't defined and calls to it don't compile
+    if (!Failed)
+        VM.Define(std::move(Function));
+    else if (Reserved)
+        VM.Unreserve(Name);
+
+    Function = nullptr;
+}
+
+void BytecodeCompiler::Visit(UnaryExpression &Expression) {
+    unsigned Base = AllocateRegister();
+
+    Expression.GetOperand().Accept(*this);
+    MoveCurrentTo(Base);
+    NextRegister = Base + 1;
+
+    auto Name = std::string("unary") + Expression.GetOperator();
+    if (!FunctionDeclarations.count(Name)) {
+        LogError("Unknown unary operator");
+        return;
+    }
+
+    EmitCall(Name, Base, 1);
+}
+
+void BytecodeCompiler::Visit(BinaryExpression &Expression) {
+    if (Expression.GetOperator() == '=') {
+        auto *LeftSide = dynamic_cast<VariableExpression *>(&Expression.GetLeftSide());
+        if (!LeftSide) {
+            LogError("Destination of '=' must be a variable");
+            return;
+        }
+
+        auto *Spawn = dynamic_cast<SpawnExpression *>(&Expression.GetRightSide());
+        if (Spawn) {
+            Spawn->GetCall().Accept(*this);
+        } else {
+            Expression.GetRightSide().Accept(*this);
+        }
+
+        auto Variable = RegistersByName.find(LeftSide->GetName());
+        if (Variable == RegistersByName.end()) {
+            LogError("Variable unknown");
+            return;
+        }
+
+        Emit(Opcode::Move, Variable->second, Current);
+        Current = Variable->second;
+
+        // like in the generated IR, the result is only in the variable
+        if (Spawn) {
+            Function->Constants.push_back(0.0);
+            Current = AllocateRegister();
+            Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+        }
+        return;
+    }
+
+    unsigned Mark = NextRegister;
+    auto Operator = Expression.GetOperator();
+
+    if (Operator != '+' && Operator != '-' && Operator != '*' && Operator != '<') {
+        // user defined operator, pass both sides as arguments
+        AllocateRegister();
+        AllocateRegister();
+
+        Expression.GetLeftSide().Accept(*this);
+        MoveCurrentTo(Mark);
+        NextRegister = Mark + 2;
+
+        Expression.GetRightSide().Accept(*this);
+        MoveCurrentTo(Mark + 1);
+        NextRegister = Mark + 2;
+
+        auto Name = std::string("binary") + Operator;
+        if (!FunctionDeclarations.count(Name)) {
+            LogError("Unknown binary operator");
+            return;
+        }
+
+        EmitCall(Name, Mark, 2);
+        return;
+    }
+
+    Expression.GetLeftSide().Accept(*this);
+    unsigned LeftSide = Current;
+
+    // a variable's register changes if the right side assigns it, so keep a copy of its value
+    auto &RightExpression = Expression.GetRightSide();
+    bool RightSideIsSimple = dynamic_cast<NumExpression *>(&RightExpression) ||
+                             dynamic_cast<VariableExpression *>(&RightExpression);
+    if (LeftSide < Mark && !RightSideIsSimple) {
+        MoveCurrentTo(AllocateRegister());
+        LeftSide = Current;
+    }
+
+    RightExpression.Accept(*this);
+    unsigned RightSide = Current;
+
+    NextRegister = Mark;
+    Current = AllocateRegister();
+
+    switch (Operator) {
+        case '+':
+            Emit(Opcode::Add, Current, LeftSide, RightSide);
+            return;
+        case '-':
+            Emit(Opcode::Sub, Current, LeftSide, RightSide);
+            return;
+        case '*':
+            Emit(Opcode::Mul, Current, LeftSide, RightSide);
+            return;
+        default:
+            Emit(Opcode::Less, Current, LeftSide, RightSide);
+            return;
+    }
+}
+
+void BytecodeCompiler::Visit(NumExpression &Expression) {
+    Function->Constants.push_back(Expression.GetVal());
+    Current = AllocateRegister();
+    Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+}
+
+void BytecodeCompiler::Visit(ConditionalExpression &Expression) {
+    unsigned Result = AllocateRegister();
+
+    Expression.GetCondition().Accept(*this);
+    unsigned ToOtherwise = Emit(Opcode::JumpIfFalse, Current);
+    NextRegister = Result + 1;
+
+    // emit then:
+    Expression.GetThen().Accept(*this);
+    MoveCurrentTo(Result);
+    NextRegister = Result + 1;
+    unsigned ToMerge = Emit(Opcode::Jump, 0);
+
+    // emit otherwise:
+    PatchJump(ToOtherwise);
+    Expression.GetOtherwise().Accept(*this);
+    MoveCurrentTo(Result);
+    NextRegister = Result + 1;
+
+    // emit merge:
+    PatchJump(ToMerge);
+}
+
+void BytecodeCompiler::Visit(LoopExpression &Expression) {
+    if (Expression.IsParallel()) {
+        LogError("Parallel loops are not supported by the VM");
+        return;
+    }
+
+    if (Expression.GetReduction() != Reduction::None && Expression.GetCountedEnd()) {
+        CompileCountedReduction(Expression);
+        return;
+    }
+
+    // same order as the generated IR: body, step, while (with the variable's old value), then increment
+    std::string VariableName = Expression.GetVariableName();
+    unsigned Mark = NextRegister;
+
+    // emit let:
+    Expression.GetLet().Accept(*this);
+    ReleaseRegisters(Mark);
+    if (Current < Mark)
+        MoveCurrentTo(AllocateRegister());
+    unsigned Variable = Current;
+
+    auto Original = RegistersByName.find(VariableName);
+    bool HadOriginal = Original != RegistersByName.end();
+    unsigned OriginalRegister = HadOriginal ? Original->second : 0;
+    RegistersByName[VariableName] = Variable;
+
+    // the accumulator of a reduction lives right after the variable
+    enum Reduction Reduction = Expression.GetReduction();
+    unsigned Accumulator = Variable;
+    if (Reduction != Reduction::None) {
+        Accumulator = AllocateRegister();
+        Function->Constants.push_back(GetReductionIdentity(Reduction));
+        Emit(Opcode::Const, Accumulator, Function->Constants.size() - 1);
+    }
+
+    unsigned Loop = Function->Code.size();
+
+    // emit loop body:
+    Expression.GetBody().Accept(*this);
+    if (Reduction != Reduction::None)
+        EmitReduction(Reduction, Accumulator, Current);
+    NextRegister = Accumulator + 1;
+
+    // emit step:
+    unsigned Step = AllocateRegister();
+    if (Expression.HasStep()) {
+        Expression.GetStep().Accept(*this);
+        MoveCurrentTo(Step);
+    } else {
+        // use 1
+        Function->Constants.push_back(1.0);
+        Emit(Opcode::Const, Step, Function->Constants.size() - 1);
+    }
+    NextRegister = Step + 1;
+
+    // emit while:
+    Expression.GetWhile().Accept(*this);
+    if (Current == Variable)
+        MoveCurrentTo(AllocateRegister());
+    unsigned While = Current;
+
+    Emit(Opcode::Add, Variable, Variable, Step);
+    Emit(Opcode::JumpIfTrue, While, Loop);
+
+    if (HadOriginal) {
+        RegistersByName[VariableName] = OriginalRegister;
+    } else {
+        RegistersByName.erase(VariableName);
+    }
+
+    NextRegister = Mark;
+    if (Reduction != Reduction::None) {
+        Current = Accumulator;
+        MoveCurrentTo(AllocateRegister());
+        return;
+    }
+
+    // return 0 always
+    Function->Constants.push_back(0.0);
+    Current = AllocateRegister();
+    Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+}
+
+// same iterations as the generated IR: start, end and step are evaluated once and the variable is computed from
+// the iteration's index
+void BytecodeCompiler::CompileCountedReduction(LoopExpression &Expression) {
+    std::string VariableName = Expression.GetVariableName();
+    enum Reduction Reduction = Expression.GetReduction();
+    unsigned Mark = NextRegister;
+
+    // emit start, end and step:
+    Expression.GetLet().Accept(*this);
+    ReleaseRegisters(Mark);
+    if (Current < Mark)
+        MoveCurrentTo(AllocateRegister());
+    unsigned Start = Current;
+
+    unsigned End = AllocateRegister();
+    Expression.GetCountedEnd()->Accept(*this);
+    MoveCurrentTo(End);
+    NextRegister = End + 1;
+
+    unsigned Step = AllocateRegister();
+    if (Expression.HasStep()) {
+        Expression.GetStep().Accept(*this);
+        MoveCurrentTo(Step);
+    } else {
+        // use 1
+        Function->Constants.push_back(1.0);
+        Emit(Opcode::Const, Step, Function->Constants.size() - 1);
+    }
+    NextRegister = Step + 1;
+
+    Function->Constants.push_back(0.0);
+    unsigned Zero = Function->Constants.size() - 1;
+    Function->Constants.push_back(1.0);
+    unsigned One = Function->Constants.size() - 1;
+
+    // loops without a positive step run once
+    unsigned Positive = AllocateRegister();
+    Emit(Opcode::Const, Positive, Zero);
+    Emit(Opcode::Less, Positive, Positive, Step);
+
+    unsigned Index = AllocateRegister();
+    Emit(Opcode::Const, Index, Zero);
+    unsigned Increment = AllocateRegister();
+    Emit(Opcode::Const, Increment, One);
+
+    unsigned Accumulator = AllocateRegister();
+    Function->Constants.push_back(GetReductionIdentity(Reduction));
+    Emit(Opcode::Const, Accumulator, Function->Constants.size() - 1);
+
+    unsigned Variable = AllocateRegister();
+    unsigned Continue = AllocateRegister();
+
+    auto Original = RegistersByName.find(VariableName);
+    bool HadOriginal = Original != RegistersByName.end();
+    unsigned OriginalRegister = HadOriginal ? Original->second : 0;
+    RegistersByName[VariableName] = Variable;
+
+    unsigned Loop = Function->Code.size();
+    Emit(Opcode::Mul, Variable, Index, Step);
+    Emit(Opcode::Add, Variable, Start, Variable);
+    Emit(Opcode::Less, Continue, Variable, End);
+
+    // emit loop body:
+    Expression.GetBody().Accept(*this);
+    EmitReduction(Reduction, Accumulator, Current);
+    NextRegister = Continue + 1;
+
+    Emit(Opcode::Add, Index, Index, Increment);
+    unsigned ToAfter = Emit(Opcode::JumpIfFalse, Continue);
+    Emit(Opcode::JumpIfTrue, Positive, Loop);
+    PatchJump(ToAfter);
+
+    if (HadOriginal) {
+        RegistersByName[VariableName] = OriginalRegister;
+    } else {
+        RegistersByName.erase(VariableName);
+    }
+
+    NextRegister = Mark;
+    Current = Accumulator;
+    MoveCurrentTo(AllocateRegister());
+}
+
+double BytecodeCompiler::GetReductionIdentity(enum Reduction Reduction) {
+    switch (Reduction) {
+        case Reduction::Product:
+            return 1.0;
+        case Reduction::Min:
+            return std::numeric_limits<double>::infinity();
+        case Reduction::Max:
+            return -std::numeric_limits<double>::infinity();
+        default:
+            return 0.0;
+    }
+}
+
+// min and max keep the accumulator when the value is NaN, like llvm.minnum and llvm.maxnum
+void BytecodeCompiler::EmitReduction(enum Reduction Reduction, unsigned Accumulator, unsigned Value) {
+    switch (Reduction) {
+        case Reduction::Product:
+            Emit(Opcode::Mul, Accumulator, Accumulator, Value);
+            return;
+        case Reduction::Min:
+        case Reduction::Max: {
+            unsigned Replace = AllocateRegister();
+            if (Reduction == Reduction::Min) {
+                Emit(Opcode::Less, Replace, Value, Accumulator);
+            } else {
+                Emit(Opcode::Less, Replace, Accumulator, Value);
+            }
+            unsigned ToKeep = Emit(Opcode::JumpIfFalse, Replace);
+            Emit(Opcode::Move, Accumulator, Value);
+            PatchJump(ToKeep);
+            return;
+        }
+        default:
+            Emit(Opcode::Add, Accumulator, Accumulator, Value);
+            return;
+    }
+}
+
+// The VM runs spawned calls right away (the serial elision of the program), which makes `sync` a no-op.
+void BytecodeCompiler::Visit(SpawnExpression &Expression) {
+    unsigned Mark = NextRegister;
+    Expression.GetCall().Accept(*this);
+
+    // nothing keeps the result
+    NextRegister = Mark;
+    Function->Constants.push_back(0.0);
+    Current = AllocateRegister();
+    Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+}
+
+void BytecodeCompiler::Visit(SyncExpression &Expression) {
+    Function->Constants.push_back(0.0);
+    Current = AllocateRegister();
+    Emit(Opcode::Const, Current, Function->Constants.size() - 1);
+}
+
+void BytecodeCompiler::Register(std::unique_ptr<FunctionDeclaration> Declaration) {
+    FunctionDeclarations[Declaration->GetName()] = std::move(Declaration);
+}
@@ -0,0 +1,88 @@
+#ifndef SOLID_LANG_BYTECODECOMPILER_H
+#define SOLID_LANG_BYTECODECOMPILER_H
+
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include "ExpressionVisitor.h"
+#include "VM.h"
+
+// Compiles function definitions to register based bytecode and defines them in the VM.
+// Locals and temporaries are allocated like a stack: registers from NextRegister on are free,
+// so the arguments of a call are always the last registers in use.
+class BytecodeCompiler : public ExpressionVisitor {
+    class VM &VM;
+
+    std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations;
+
+    std::map<std::string, unsigned> RegistersByName;
+
+    std::unique_ptr<BytecodeFunction> Function;
+
+    unsigned NextRegister = 0;
+
+    // register holding the value of the last visited expression
+    unsigned Current = 0;
+
+    bool Failed = false;
+
+    unsigned AllocateRegister();
+
+    // frees the registers from Mark on, except for the current value
+    void ReleaseRegisters(unsigned Mark);
+
+    // moves the current value into Register, if it's not there already
+    void MoveCurrentTo(unsigned Register);
+
+    unsigned Emit(Opcode Op, unsigned A, unsigned B = 0, unsigned C = 0);
+
+    void PatchJump(unsigned Jump);
+
+    void CompileCountedReduction(LoopExpression &Expression);
+
+    static double GetReductionIdentity(enum Reduction Reduction);
+
+    void EmitReduction(enum Reduction Reduction, unsigned Accumulator, unsigned Value);
+
+    // calls Name with the arguments in the registers from Base on, the result ends up in Base
+    void EmitCall(const std::string &Name, unsigned Base, unsigned ArgumentCount);
+
+public:
+    BytecodeCompiler(class VM &VM, std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations)
+            : VM(VM), FunctionDeclarations(FunctionDeclarations) {}
+
+    void Visit(VariableExpression &Expression) override;
+
+    void Visit(VariableDefinition &Expression) override;
+
+    void Visit(FunctionCall &Expression) override;
+
+    void Visit(FunctionDeclaration &Expression) override;
+
+    void Visit(FunctionDefinition &Expression) override;
+
+    void Visit(UnaryExpression &Expression) override;
+
+    void Visit(BinaryExpression &Expression) override;
+
+    void Visit(NumExpression &Expression) override;
+
+    void Visit(ConditionalExpression &Expression) override;
+
+    void Visit(LoopExpression &Expression) override;
+
+    void Visit(SpawnExpression &Expression) override;
+
+    void Visit(SyncExpression &Expression) override;
+
+    void Register(std::unique_ptr<FunctionDeclaration> Declaration) override;
+
+    void LogError(const char *Message) {
+        fprintf(stderr, "Error: %s\n", Message);
+        Failed = true;
+    }
+};
+
+#endif
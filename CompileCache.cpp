@@ -0,0 +1,165 @@
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <vector>
+#include "CompileCache.h"
+
+CompileCache::CompileCache(std::string Directory, uint64_t SizeLimit)
+        : Directory(std::move(Directory)), SizeLimit(SizeLimit) {
+    sys::fs::create_directories(this->Directory);
+}
+
+std::string CompileCache::Hash(StringRef Data) {
+    return toHex(SHA1::hash(arrayRefFromStringRef(Data)), true);
+}
+
+std::string CompileCache::GetPath(StringRef Key) {
+    SmallString<128> Path(Directory);
+    sys::path::append(Path, Key + ".o");
+    return std::string(Path);
+}
+
+std::unique_ptr<MemoryBuffer> CompileCache::Get(StringRef Key) {
+    std::string Path = GetPath(Key);
+
+    auto Object = MemoryBuffer::getFile(Path, false, false);
+    if (!Object)
+        return nullptr;
+
+    // mark as recently used
+    int FD;
+    if (!sys::fs::openFileForWrite(Path, FD, sys::fs::CD_OpenExisting, sys::fs::OF_Append)) {
+        sys::fs::setLastAccessAndModificationTime(FD, std::chrono::system_clock::now());
+        sys::fs::closeFile(FD);
+    }
+
+    return std::move(*Object);
+}
+
+void CompileCache::Put(StringRef Key, StringRef Object) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    if (Write(Key, Object))
+        EvictLocked();
+}
+
+void CompileCache::Store(StringRef Key, StringRef Object) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Write(Key, Object);
+}
+
+void CompileCache::Evict() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    EvictLocked();
+}
+
+bool CompileCache::Write(StringRef Key, StringRef Object) {
+    // write to a temporary file first, so concurrent readers never see partial objects
+    int FD;
+    SmallString<128> TempPath;
+    SmallString<128> Model(Directory);
+    sys::path::append(Model, "%%%%%%%%%%%%.tmp");
+    if (sys::fs::createUniqueFile(Model, FD, TempPath))
+        return false;
+
+    {
+        raw_fd_ostream Out(FD, true);
+        Out << Object;
+        if (Out.has_error()) {
+            Out.clear_error();
+            sys::fs::remove(TempPath);
+            return false;
+        }
+    }
+
+    if (sys::fs::rename(TempPath, GetPath(Key))) {
+        sys::fs::remove(TempPath);
+        return false;
+    }
+    return true;
+}
+
+void CompileCache::EvictLocked() {
+    struct Entry {
+        std::string Path;
+        uint64_t Size;
+        sys::TimePoint<> LastUsed;
+    };
+
+    std::vector<Entry> Entries;
+    uint64_t TotalSize = 0;
+
+    std::error_code ErrorCode;
+    for (sys::fs::directory_iterator File(Directory, ErrorCode), End; File != End && !ErrorCode;
+         File.increment(ErrorCode)) {
+        if (sys::path::extension(File->path()) != ".o")
+            continue;
+
+        sys::fs::file_status Status;
+        if (sys::fs::status(File->path(), Status))
+            continue;
+
+        Entries.push_back({File->path(), Status.getSize(), Status.getLastModificationTime()});
+        TotalSize += Status.getSize();
+    }
+
+    if (TotalSize <= SizeLimit)
+        return;
+
+    std::sort(Entries.begin(), Entries.end(), [](const Entry &A, const Entry &B) {
+        return A.LastUsed < B.LastUsed;
+    });
+
+    for (auto &Oldest: Entries) {
+        if (TotalSize <= SizeLimit)
+            break;
+        if (!sys::fs::remove(Oldest.Path))
+            TotalSize -= Oldest.Size;
+    }
+}
+
+bool JITObjectCache::IsCacheable(const Module &M) {
+    // top level expressions are compiled, run and removed again, caching them would only churn the cache
+    for (auto &Func: M) {
+        if (!Func.isDeclaration() && Func.getName().startswith("__anonymous_top_level_expr"))
+            return false;
+    }
+    return true;
+}
+
+std::string JITObjectCache::GetKey(const Module &M) {
+    std::string Data = Configuration;
+    raw_string_ostream Stream(Data);
+    M.print(Stream, nullptr);
+    return CompileCache::Hash(Stream.str());
+}
+
+std::unique_ptr<MemoryBuffer> JITObjectCache::getObject(const Module *M) {
+    if (!IsCacheable(*M))
+        return nullptr;
+
+    std::string Key = GetKey(*M);
+    if (auto Object = Cache.Get(Key))
+        return Object;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    PendingKeys[M] = std::move(Key);
+    return nullptr;
+}
+
+void JITObjectCache::notifyObjectCompiled(const Module *M, MemoryBufferRef Object) {
+    std::string Key;
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        auto Pending = PendingKeys.find(M);
+        if (Pending == PendingKeys.end())
+            return;
+
+        Key = std::move(Pending->second);
+        PendingKeys.erase(Pending);
+    }
+
+    Cache.Put(Key, Object.getBuffer());
+}
@@ -0,0 +1,71 @@
+#ifndef SOLID_LANG_COMPILECACHE_H
+#define SOLID_LANG_COMPILECACHE_H
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <map>
+#include <mutex>
+#include <string>
+
+using namespace llvm;
+
+// Directory of compiled objects keyed by content hash.
+// The directory is kept below a size limit by evicting the least recently used objects (by modification time,
+// which is refreshed on every hit), so it can be shared by many (sequential or concurrent) processes.
+class CompileCache {
+
+public:
+    CompileCache(std::string Directory, uint64_t SizeLimit);
+
+    std::unique_ptr<MemoryBuffer> Get(StringRef Key);
+
+    // stores Object and evicts objects above the size limit
+    void Put(StringRef Key, StringRef Object);
+
+    // stores Object without evicting, for many objects in a row followed by one Evict()
+    void Store(StringRef Key, StringRef Object);
+
+    void Evict();
+
+    static std::string Hash(StringRef Data);
+
+private:
+    std::string Directory;
+    uint64_t SizeLimit;
+
+    std::mutex Mutex;
+
+    std::string GetPath(StringRef Key);
+
+    bool Write(StringRef Key, StringRef Object);
+
+    void EvictLocked();
+};
+
+// Lets the JIT's compile layer skip codegen for modules it has compiled before (in this or an earlier session).
+// Objects are keyed by the optimized IR plus the target and optimization configuration.
+class JITObjectCache : public ObjectCache {
+
+public:
+    JITObjectCache(std::string Directory, uint64_t SizeLimit, std::string Configuration)
+            : Cache(std::move(Directory), SizeLimit), Configuration(std::move(Configuration)) {}
+
+    std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+    void notifyObjectCompiled(const Module *M, MemoryBufferRef Object) override;
+
+private:
+    CompileCache Cache;
+    std::string Configuration;
+
+    // keys of the modules that missed in `getObject` and are being compiled
+    std::mutex Mutex;
+    std::map<const Module *, std::string> PendingKeys;
+
+    std::string GetKey(const Module &M);
+
+    static bool IsCacheable(const Module &M);
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Timer.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include "CompileStats.h"
+
+namespace {
+
+const int PhaseCount = (int) Phase::ObjectEmission + 1;
+
+const char *PhaseNames[PhaseCount] = {"Lexing", "Parsing", "IR generation", "Function passes", "JIT function passes",
+                                      "Optimization pipeline", "JIT materialization", "Object emission"};
+
+const char *PhaseKeys[PhaseCount] = {"lexing", "parsing", "ir_generation", "function_passes", "jit_passes",
+                                     "optimization_pipeline", "materialization", "object_emission"};
+
+struct PhaseStats {
+    int64_t Wall = 0;
+    int64_t CPU = 0;
+    uint64_t Calls = 0;
+    // of the process when the phase ended the last time
+    uint64_t PeakMemory = 0;
+};
+
+bool Enabled = false;
+int64_t EnabledAt;
+
+std::mutex StatsMutex;
+PhaseStats Phases[PhaseCount];
+
+// Lexing is timed for every token, far too often for StatsMutex or the CPU clock (a system call). Every thread adds up
+// its own lexing time instead, the report collects it from the threads that are still running. Lexing doesn't wait for
+// anything, so its CPU time is its wall time.
+struct LexingStats;
+std::vector<LexingStats *> LexingThreads;
+
+struct LexingStats {
+    // only written by the thread
+    std::atomic<int64_t> Wall{0};
+    std::atomic<uint64_t> Calls{0};
+
+    LexingStats() {
+        std::lock_guard<std::mutex> Lock(StatsMutex);
+        LexingThreads.push_back(this);
+    }
+
+    ~LexingStats() {
+        std::lock_guard<std::mutex> Lock(StatsMutex);
+        auto &Stats = Phases[(int) Phase::Lexing];
+        Stats.Wall += Wall;
+        Stats.CPU += Wall;
+        Stats.Calls += Calls;
+        LexingThreads.erase(std::find(LexingThreads.begin(), LexingThreads.end(), this));
+    }
+
+    void Add(int64_t Time) {
+        Wall.store(Wall.load(std::memory_order_relaxed) + Time, std::memory_order_relaxed);
+        Calls.store(Calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+thread_local LexingStats ThreadLexing;
+
+std::atomic<uint64_t> ASTNodes{0};
+std::atomic<uint64_t> Functions{0};
+std::atomic<uint64_t> Instructions{0};
+
+thread_local PhaseTimer *CurrentTimer = nullptr;
+
+std::mutex PassTimingMutex;
+PassInstrumentationCallbacks *PassTimingCallbacks = nullptr;
+
+int64_t GetWallTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t GetThreadCPUTime() {
+    timespec Time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time);
+    return (int64_t) Time.tv_sec * 1000000000 + Time.tv_nsec;
+}
+
+int64_t GetProcessCPUTime() {
+    timespec Time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Time);
+    return (int64_t) Time.tv_sec * 1000000000 + Time.tv_nsec;
+}
+
+uint64_t GetPeakMemory() {
+    rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+#ifdef __APPLE__
+    return Usage.ru_maxrss;
+#else
+    return (uint64_t) Usage.ru_maxrss * 1024;
+#endif
+}
+
+double Seconds(int64_t Nanoseconds) {
+    return Nanoseconds / 1e9;
+}
+
+double Megabytes(uint64_t Bytes) {
+    return Bytes / (1024.0 * 1024.0);
+}
+
+}
+
+void EnableCompileStats() {
+    Enabled = true;
+    EnabledAt = GetWallTime();
+
+    // printed with the report instead of at exit
+    EnableStatistics(false);
+    TimePassesIsEnabled = true;
+
+    // never destroyed, which would print its timers
+    auto *Handler = new TimePassesHandler(true);
+    PassTimingCallbacks = new PassInstrumentationCallbacks();
+    Handler->registerCallbacks(*PassTimingCallbacks);
+}
+
+PhaseTimer::PhaseTimer(enum Phase Phase) : Phase(Phase), Running(Enabled) {
+    if (!Running)
+        return;
+
+    Outer = CurrentTimer;
+    CurrentTimer = this;
+    WallStart = GetWallTime();
+    CPUStart = Phase == Phase::Lexing ? 0 : GetThreadCPUTime();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (!Running)
+        return;
+
+    int64_t Wall = GetWallTime() - WallStart;
+    int64_t CPU = Phase == Phase::Lexing ? Wall : GetThreadCPUTime() - CPUStart;
+    CurrentTimer = Outer;
+    if (Outer) {
+        Outer->InnerWall += Wall;
+        Outer->InnerCPU += CPU;
+    }
+
+    // nothing is timed inside of it, and it ends after every token: far too often to ask for the memory
+    if (Phase == Phase::Lexing) {
+        ThreadLexing.Add(Wall);
+        return;
+    }
+
+    uint64_t PeakMemory = GetPeakMemory();
+    std::lock_guard<std::mutex> Lock(StatsMutex);
+    auto &Stats = Phases[(int) Phase];
+    Stats.Wall += Wall - InnerWall;
+    Stats.CPU += CPU - InnerCPU;
+    Stats.Calls++;
+    Stats.PeakMemory = std::max(Stats.PeakMemory, PeakMemory);
+}
+
+void CountASTNode() {
+    if (Enabled)
+        ASTNodes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountFunction() {
+    if (Enabled)
+        Functions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountInstructions(const Module &Module) {
+    if (Enabled)
+        Instructions.fetch_add(Module.getInstructionCount(), std::memory_order_relaxed);
+}
+
+PassInstrumentationCallbacks *GetPassTimingCallbacks(std::unique_lock<std::mutex> &Lock) {
+    if (!PassTimingCallbacks)
+        return nullptr;
+
+    Lock = std::unique_lock<std::mutex>(PassTimingMutex);
+    return PassTimingCallbacks;
+}
+
+void ReportCompileStats(StatsFormat Format, raw_ostream &Out) {
+    if (!Enabled || Format == StatsFormat::None)
+        return;
+
+    int64_t Wall = GetWallTime() - EnabledAt;
+    int64_t CPU = GetProcessCPUTime();
+    uint64_t PeakMemory = GetPeakMemory();
+
+    std::lock_guard<std::mutex> Lock(StatsMutex);
+    PhaseStats Totals[PhaseCount];
+    std::copy(std::begin(Phases), std::end(Phases), Totals);
+    for (auto *Thread: LexingThreads) {
+        Totals[(int) Phase::Lexing].Wall += Thread->Wall.load(std::memory_order_relaxed);
+        Totals[(int) Phase::Lexing].CPU += Thread->Wall.load(std::memory_order_relaxed);
+        Totals[(int) Phase::Lexing].Calls += Thread->Calls.load(std::memory_order_relaxed);
+    }
+
+    if (Format == StatsFormat::JSON) {
+        json::OStream JSON(Out, 2);
+        JSON.object([&]() {
+            JSON.attribute("wall_seconds", Seconds(Wall));
+            JSON.attribute("cpu_seconds", Seconds(CPU));
+            JSON.attribute("peak_memory_bytes", (int64_t) PeakMemory);
+            JSON.attribute("functions", (int64_t) Functions.load());
+            JSON.attribute("ast_nodes", (int64_t) ASTNodes.load());
+            JSON.attribute("instructions", (int64_t) Instructions.load());
+            JSON.attributeObject("phases", [&]() {
+                for (int i = 0; i < PhaseCount; ++i) {
+                    JSON.attributeObject(PhaseKeys[i], [&]() {
+                        JSON.attribute("wall_seconds", Seconds(Totals[i].Wall));
+                        JSON.attribute("cpu_seconds", Seconds(Totals[i].CPU));
+                        JSON.attribute("calls", (int64_t) Totals[i].Calls);
+                        JSON.attribute("peak_memory_bytes", (int64_t) Totals[i].PeakMemory);
+                    });
+                }
+            });
+            // statistics (of LLVM builds with assertions) and pass timers
+            JSON.attributeBegin("llvm");
+            JSON.rawValue([](raw_ostream &Out) { PrintStatisticsJSON(Out); });
+            JSON.attributeEnd();
+        });
+        Out << "\n";
+    } else {
+        Out << "===" << std::string(73, '-') << "===\n";
+        Out << "                         Solid compile time report\n";
+        Out << "===" << std::string(73, '-') << "===\n";
+        Out << format("  Total: %.4f s wall, %.4f s CPU, %.1f MB peak memory\n", Seconds(Wall), Seconds(CPU),
+                      Megabytes(PeakMemory));
+        Out << format("  %llu functions, %llu AST nodes, %llu instructions compiled\n\n",
+                      (unsigned long long) Functions.load(), (unsigned long long) ASTNodes.load(),
+                      (unsigned long long) Instructions.load());
+        Out << "   Wall (s)    CPU (s)      Calls  Peak memory (MB)  Phase\n";
+        for (int i = 0; i < PhaseCount; ++i) {
+            Out << format("  %9.4f  %9.4f  %9llu  %16.1f  %s\n", Seconds(Totals[i].Wall), Seconds(Totals[i].CPU),
+                          (unsigned long long) Totals[i].Calls, Megabytes(Totals[i].PeakMemory), PhaseNames[i]);
+        }
+        Out << "\n";
+
+        TimerGroup::printAll(Out);
+        PrintStatistics(Out);
+    }
+
+    // already printed, not again at exit
+    TimerGroup::clearAll();
+    Out.flush();
+}
@@ -0,0 +1,75 @@
+#ifndef SOLID_LANG_COMPILESTATS_H
+#define SOLID_LANG_COMPILESTATS_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <mutex>
+
+using namespace llvm;
+
+// Where the compiler spends its time, reported with --time-report and --stats. Phases are timed by the threads running
+// them (compile threads included) and added up for the whole process, with LLVM's pass timers and statistics next to
+// them. Nothing is measured unless the stats have been enabled.
+
+enum class Phase {
+    // timed per thread without the CPU clock, its CPU time is its wall time
+    Lexing,
+    Parsing,
+    IRGeneration,
+    // InitLLVM's function passes, run as object files' functions are generated
+    FunctionPasses,
+    // JIT::OptimizeModule's function passes
+    JITPasses,
+    // LLVM's default pipelines: O2 of object files (with runtime bitcode) and O3 of tiered or aggressively optimized
+    // code
+    OptimizationPipeline,
+    // machine code generation of the modules the JIT materializes
+    Materialization,
+    ObjectEmission,
+};
+
+enum class StatsFormat {
+    None,
+    Text,
+    JSON,
+};
+
+// Starts measuring, before any compilation
+void EnableCompileStats();
+
+// Measures wall and CPU time of a phase while in scope, without the phases timed inside of it (like lexing in parsing)
+class PhaseTimer {
+    enum Phase Phase;
+    bool Running;
+    PhaseTimer *Outer;
+    int64_t WallStart;
+    int64_t CPUStart;
+    int64_t InnerWall = 0;
+    int64_t InnerCPU = 0;
+
+public:
+    explicit PhaseTimer(enum Phase Phase);
+
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+};
+
+void CountASTNode();
+
+void CountFunction();
+
+// counts the instructions of a module that is compiled to machine code
+void CountInstructions(const Module &Module);
+
+// Instrumentation of the new pass manager timing its passes, null without stats. Pass timers aren't thread-safe,
+// pipelines using them hold Lock while they run.
+PassInstrumentationCallbacks *GetPassTimingCallbacks(std::unique_lock<std::mutex> &Lock);
+
+void ReportCompileStats(StatsFormat Format, raw_ostream &Out);
+
+#endif
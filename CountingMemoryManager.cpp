@@ -0,0 +1,36 @@
+#include "CountingMemoryManager.h"
+
+CodeMemoryStats CountingMemoryManager::Counter::GetStats() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Stats;
+}
+
+void CountingMemoryManager::Counter::Add(int64_t CodeBytes, int64_t DataBytes, int64_t Allocations) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Stats.CodeBytes += CodeBytes;
+    Stats.DataBytes += DataBytes;
+    Stats.UsedBytes += CodeBytes + DataBytes;
+    Stats.Allocations += Allocations;
+}
+
+CountingMemoryManager::CountingMemoryManager(Counter &Total) : Total(Total) {
+    Total.Add(0, 0, 1);
+}
+
+CountingMemoryManager::~CountingMemoryManager() {
+    Total.Add(-(int64_t) CodeBytes, -(int64_t) DataBytes, -1);
+}
+
+uint8_t *CountingMemoryManager::allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+                                                    StringRef SectionName) {
+    CodeBytes += Size;
+    Total.Add(Size, 0, 0);
+    return SectionMemoryManager::allocateCodeSection(Size, Alignment, SectionID, SectionName);
+}
+
+uint8_t *CountingMemoryManager::allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+                                                    StringRef SectionName, bool IsReadOnly) {
+    DataBytes += Size;
+    Total.Add(0, Size, 0);
+    return SectionMemoryManager::allocateDataSection(Size, Alignment, SectionID, SectionName, IsReadOnly);
+}
@@ -0,0 +1,44 @@
+#ifndef SOLID_LANG_COUNTINGMEMORYMANAGER_H
+#define SOLID_LANG_COUNTINGMEMORYMANAGER_H
+
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include <mutex>
+#include "SlabMemoryManager.h"
+
+using namespace llvm;
+
+// RuntimeDyld memory manager that counts the code and data sections of live objects.
+// RuntimeDyld creates one per object and destroys it when the object is removed.
+class CountingMemoryManager : public SectionMemoryManager {
+
+public:
+    // Totals of all memory managers of a JIT
+    class Counter {
+
+    public:
+        CodeMemoryStats GetStats();
+
+        void Add(int64_t CodeBytes, int64_t DataBytes, int64_t Allocations);
+
+    private:
+        std::mutex Mutex;
+        CodeMemoryStats Stats;
+    };
+
+    explicit CountingMemoryManager(Counter &Total);
+
+    ~CountingMemoryManager() override;
+
+    uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
+                                 StringRef SectionName) override;
+
+    uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned SectionID, StringRef SectionName,
+                                 bool IsReadOnly) override;
+
+private:
+    Counter &Total;
+    uint64_t CodeBytes = 0;
+    uint64_t DataBytes = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DataRuntime.h"
+
+namespace {
+
+const int MaxFiles = 64;
+
+// text is split into chunks of at least this many bytes, parsed on separate threads
+const size_t ParseChunkSize = 4 * 1024 * 1024;
+
+struct File {
+    const double *Values = nullptr;
+    uint64_t Size = 0;
+    // values parsed from text, binary files are mapped instead
+    std::vector<double> Parsed;
+};
+
+bool IsSeparator(char Character) {
+    return isspace((unsigned char) Character) || Character == ',' || Character == ';' || Character == '|';
+}
+
+bool IsBinary(const std::string &Path) {
+    auto EndsWith = [&](const char *Extension) {
+        size_t Length = strlen(Extension);
+        return Path.size() >= Length && Path.compare(Path.size() - Length, Length, Extension) == 0;
+    };
+    return EndsWith(".bin") || EndsWith(".f64");
+}
+
+bool ParseField(const char *Begin, const char *End, double &Value) {
+#ifdef __cpp_lib_to_chars
+    // from_chars doesn't take a leading '+'
+    if (*Begin == '+')
+        ++Begin;
+    auto Result = std::from_chars(Begin, End, Value);
+    return Result.ec == std::errc() && Result.ptr == End;
+#else
+    // strtod needs a terminated string, which the mapping isn't
+    char Field[64];
+    size_t Length = End - Begin;
+    if (Length >= sizeof(Field))
+        return false;
+    memcpy(Field, Begin, Length);
+    Field[Length] = 0;
+    char *Parsed;
+    Value = strtod(Field, &Parsed);
+    return Parsed == Field + Length;
+#endif
+}
+
+void ParseChunk(const char *Begin, const char *End, std::vector<double> &Values) {
+    const char *Position = Begin;
+    while (Position < End) {
+        while (Position < End && IsSeparator(*Position))
+            ++Position;
+
+        const char *FieldBegin = Position;
+        while (Position < End && !IsSeparator(*Position))
+            ++Position;
+
+        double Value;
+        if (Position > FieldBegin && ParseField(FieldBegin, Position, Value))
+            Values.push_back(Value);
+    }
+}
+
+void ParseText(const char *Text, size_t Size, std::vector<double> &Values) {
+    size_t Threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t Chunks = std::max<size_t>(1, std::min(Threads, Size / ParseChunkSize));
+
+    // chunks start at separators, so no field is split
+    std::vector<size_t> Boundaries = {0};
+    for (size_t i = 1; i < Chunks; ++i) {
+        size_t Boundary = std::max(Boundaries.back(), Size / Chunks * i);
+        while (Boundary < Size && !IsSeparator(Text[Boundary]))
+            ++Boundary;
+        Boundaries.push_back(Boundary);
+    }
+    Boundaries.push_back(Size);
+
+    std::vector<std::vector<double>> ChunkValues(Chunks);
+    std::vector<std::thread> Workers;
+    for (size_t i = 1; i < Chunks; ++i)
+        Workers.emplace_back(ParseChunk, Text + Boundaries[i], Text + Boundaries[i + 1], std::ref(ChunkValues[i]));
+    ParseChunk(Text, Text + Boundaries[1], ChunkValues[0]);
+    for (auto &Worker: Workers)
+        Worker.join();
+
+    size_t Total = 0;
+    for (auto &Chunk: ChunkValues)
+        Total += Chunk.size();
+    Values.reserve(Total);
+    for (auto &Chunk: ChunkValues)
+        Values.insert(Values.end(), Chunk.begin(), Chunk.end());
+}
+
+// Files are only appended, readers see them once Count has been published
+class Data {
+    File Files[MaxFiles];
+    std::atomic<int> Count{0};
+    std::mutex OpenMutex;
+
+public:
+    Data() {
+        const char *Paths = getenv("SOLID_DATA");
+        if (!Paths)
+            return;
+
+        std::string Remaining(Paths);
+        while (!Remaining.empty()) {
+            size_t End = std::min(Remaining.find(':'), Remaining.size());
+            std::string Path = Remaining.substr(0, End);
+            if (!Path.empty() && Open(Path) < 0)
+                fprintf(stderr, "Error: could not read data file %s\n", Path.c_str());
+            Remaining.erase(0, End + 1);
+        }
+    }
+
+    // never destroyed, the mappings stay valid while threads may still read them
+    static Data &Get() {
+        static Data *Instance = new Data();
+        return *Instance;
+    }
+
+    const File *Lookup(int Index) const {
+        if (Index < 0 || Index >= Count.load(std::memory_order_acquire))
+            return nullptr;
+        return &Files[Index];
+    }
+
+    int Open(const std::string &Path) {
+        std::lock_guard<std::mutex> Lock(OpenMutex);
+        int Index = Count.load(std::memory_order_relaxed);
+        if (Index == MaxFiles)
+            return -1;
+
+        int Descriptor = open(Path.c_str(), O_RDONLY);
+        if (Descriptor < 0)
+            return -1;
+
+        struct stat Status;
+        if (fstat(Descriptor, &Status) != 0) {
+            close(Descriptor);
+            return -1;
+        }
+
+        auto &File = Files[Index];
+        size_t Size = Status.st_size;
+        void *Mapping = nullptr;
+        if (Size > 0) {
+            Mapping = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+            if (Mapping == MAP_FAILED) {
+                close(Descriptor);
+                return -1;
+            }
+        }
+        close(Descriptor);
+
+        if (IsBinary(Path)) {
+            // read front to back most of the time
+            if (Mapping)
+                madvise(Mapping, Size, MADV_SEQUENTIAL);
+            File.Values = static_cast<const double *>(Mapping);
+            File.Size = Size / sizeof(double);
+        } else {
+            if (Mapping) {
+                madvise(Mapping, Size, MADV_SEQUENTIAL);
+                ParseText(static_cast<const char *>(Mapping), Size, File.Parsed);
+                munmap(Mapping, Size);
+            }
+            File.Values = File.Parsed.data();
+            File.Size = File.Parsed.size();
+        }
+
+        Count.store(Index + 1, std::memory_order_release);
+        return Index;
+    }
+};
+
+}
+
+int __solid_open_data(const char *Path) {
+    return Data::Get().Open(Path);
+}
+
+uint64_t __solid_data_size(int File) {
+    auto *Opened = Data::Get().Lookup(File);
+    return Opened ? Opened->Size : 0;
+}
+
+const double *__solid_data_values(int File) {
+    auto *Opened = Data::Get().Lookup(File);
+    return Opened ? Opened->Values : nullptr;
+}
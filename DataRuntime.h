@@ -0,0 +1,25 @@
+#ifndef SOLID_LANG_DATARUNTIME_H
+#define SOLID_LANG_DATARUNTIME_H
+
+#include <cstdint>
+
+// Input data of the `data` and `datasize` built-ins: files of doubles, numbered in the order they are opened. The
+// paths in SOLID_DATA (separated by ':') are opened first. Binary files (`.bin` or `.f64`) hold raw doubles in the
+// machine's byte order and are memory-mapped as they are. Text files (any other name) hold numbers separated by
+// whitespace, ',', ';' or '|', they are mapped and parsed in one go, in parallel for big files. Fields that aren't
+// numbers, like headers, are skipped.
+
+extern "C" {
+
+// Opens a data file, returns its number or -1 if it can't be read.
+int __solid_open_data(const char *Path);
+
+// Number of values in File, 0 for files that aren't open.
+__attribute__((pure)) uint64_t __solid_data_size(int File);
+
+// Values of File, which stay valid until the program exits. Null for files that aren't open.
+__attribute__((pure)) const double *__solid_data_values(int File);
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+#include <map>
+#include "Driver.h"
+#include "ObjectCompiler.h"
+#include "SolidLang.h"
+
+int CompileFiles(const std::vector<std::string> &InputFiles, const std::string &OutputFile,
+                 const std::string &Prelude, unsigned Jobs, const JITOptions &Options, Emit Emit,
+                 OptimizationLevel Level, const std::string &RuntimeDirectory) {
+    bool Link = !OutputFile.empty();
+
+    std::vector<std::string> Objects;
+    for (auto &InputFile: InputFiles) {
+        if (!Link) {
+            Objects.push_back(InputFile.substr(0, InputFile.find_last_of('.')) + ".o");
+            continue;
+        }
+
+        SmallString<128> Object;
+        if (auto ErrorCode = sys::fs::createTemporaryFile("solid", "o", Object)) {
+            fprintf(stderr, "Error: could not create a temporary file: %s\n", ErrorCode.message().c_str());
+            return 1;
+        }
+        Objects.push_back(Object.str().str());
+    }
+
+    std::vector<std::vector<ExportedFunction>> Functions(InputFiles.size());
+    std::atomic<unsigned> Failed{0};
+    {
+        ThreadPool Pool(hardware_concurrency(Jobs));
+        for (size_t i = 0; i < InputFiles.size(); ++i) {
+            Pool.async([&, i]() {
+                SolidLang Compiler(InputFiles[i], Objects[i], false, Options, false, false, Backend::JIT, false,
+                                   Prelude);
+                Compiler.SetOptimizationLevel(Level);
+                if (Link)
+                    Compiler.SetQuiet();
+                if (Compiler.Start() != 0)
+                    ++Failed;
+                Functions[i] = Compiler.GetExportedFunctions();
+            });
+        }
+        Pool.wait();
+    }
+
+    int ExitCode = Failed ? 1 : 0;
+    if (Link) {
+        if (!Failed) {
+            // every file defines the prelude's functions
+            std::map<std::string, ExportedFunction> UniqueFunctions;
+            for (auto &FileFunctions: Functions) {
+                for (auto &Function: FileFunctions)
+                    UniqueFunctions.emplace(Function.Name, Function);
+            }
+            std::vector<ExportedFunction> LinkedFunctions;
+            for (auto &[Name, Function]: UniqueFunctions)
+                LinkedFunctions.push_back(Function);
+
+            std::vector<std::string> Names;
+            for (auto &InputFile: InputFiles)
+                Names.push_back(sys::path::stem(InputFile).str() + ".o");
+
+            Error Result = WriteLibrary(Emit, Objects, Names, LinkedFunctions, OutputFile, RuntimeDirectory,
+                                        Options.VectorLibrary);
+            if (!Result)
+                Result = WriteHeader(LinkedFunctions, OutputFile);
+
+            if (Result) {
+                fprintf(stderr, "Error: %s\n", toString(std::move(Result)).c_str());
+                ExitCode = 1;
+            } else {
+                fprintf(stdout, "created %s\n", OutputFile.c_str());
+            }
+        }
+
+        for (auto &Object: Objects)
+            sys::fs::remove(Object);
+    }
+
+    return ExitCode;
+}
@@ -0,0 +1,19 @@
+#ifndef SOLID_LANG_DRIVER_H
+#define SOLID_LANG_DRIVER_H
+
+#include <string>
+#include <vector>
+#include "JIT.h"
+#include "ObjectCompiler.h"
+
+// Compiles several input files to object files at the same time, each by its own SolidLang (with its own LLVM context)
+// on a pool of Jobs threads (0: one per core). Without an output file, every input gets an object file next to it
+// (`a.solid` becomes `a.o`). Otherwise the objects are linked into one with `ld -r` (or packaged into the library Emit
+// asks for), with a header declaring the functions of all of them. The prelude (if any) is read before every input.
+// The cache directory of Options (if any) makes the builds incremental. Shared libraries load the runtime library from
+// RuntimeDirectory (default: their own directory). Returns the exit code.
+int CompileFiles(const std::vector<std::string> &InputFiles, const std::string &OutputFile,
+                 const std::string &Prelude, unsigned Jobs, const JITOptions &Options, Emit Emit,
+                 OptimizationLevel Level = OptimizationLevel::O2, const std::string &RuntimeDirectory = "");
+
+#endif
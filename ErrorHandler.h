@@ -0,0 +1,15 @@
+#ifndef SOLID_LANG_ERRORHANDLER_H
+#define SOLID_LANG_ERRORHANDLER_H
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// Receives the messages of parse and code generation errors
+using ErrorHandler = std::function<void(const std::string &Message)>;
+
+inline void PrintError(const std::string &Message) {
+    fprintf(stderr, "Error: %s\n", Message.c_str());
+}
+
+#endif
@@ -1,5 +1,10 @@
+#include "CompileStats.h"
 #include "Expression.h"
 
+Expression::Expression() {
+    CountASTNode();
+}
+
 void VariableExpression::Accept(ExpressionVisitor &Visitor) {
     Visitor.Visit(*this);
 }
@@ -39,3 +44,23 @@ void ConditionalExpression::Accept(ExpressionVisitor &Visitor) {
 void LoopExpression::Accept(ExpressionVisitor &Visitor) {
     Visitor.Visit(*this);
 }
+
+void SpawnExpression::Accept(ExpressionVisitor &Visitor) {
+    Visitor.Visit(*this);
+}
+
+void SyncExpression::Accept(ExpressionVisitor &Visitor) {
+    Visitor.Visit(*this);
+}
+
+Expression *LoopExpression::GetCountedEnd() {
+    auto *Condition = dynamic_cast<BinaryExpression *>(While.get());
+    if (!Condition || Condition->GetOperator() != '<')
+        return nullptr;
+
+    auto *Variable = dynamic_cast<VariableExpression *>(&Condition->GetLeftSide());
+    if (!Variable || Variable->GetName() != VariableName)
+        return nullptr;
+
+    return &Condition->GetRightSide();
+}
@@ -9,6 +9,8 @@
 class Expression {
 
 public:
+    Expression();
+
     virtual ~Expression() = default;
 
     virtual void Accept(ExpressionVisitor &Visitor) = 0;
@@ -66,9 +68,23 @@ public:
     }
 };
 
+// C types of the arguments and results of natives, converted from and to doubles when they are called
+enum class NativeType {
+    F64,
+    F32,
+    I64,
+    I32,
+    Ptr,
+    // results only
+    Void,
+};
+
 class FunctionDeclaration : public Expression {
     std::string Name;
     std::vector<std::string> Arguments;
+    bool Native = false;
+    std::vector<NativeType> ArgumentTypes;
+    NativeType ReturnType = NativeType::F64;
 
 public:
     FunctionDeclaration(std::string Name, std::vector<std::string> Arguments)
@@ -83,6 +99,35 @@ public:
     std::vector<std::string> GetArguments() {
         return Arguments;
     }
+
+    // declared with `native`, not by a function definition
+    bool IsNative() {
+        return Native;
+    }
+
+    void SetNative(std::vector<NativeType> Types, NativeType Type) {
+        Native = true;
+        ArgumentTypes = std::move(Types);
+        ReturnType = Type;
+    }
+
+    // f64 unless a native declares another type
+    NativeType GetArgumentType(unsigned i) {
+        return i < ArgumentTypes.size() ? ArgumentTypes[i] : NativeType::F64;
+    }
+
+    NativeType GetReturnType() {
+        return ReturnType;
+    }
+
+    // a native with other types than f64, which only compiled code can call
+    bool IsTyped() {
+        for (auto Type: ArgumentTypes) {
+            if (Type != NativeType::F64)
+                return true;
+        }
+        return ReturnType != NativeType::F64;
+    }
 };
 
 class FunctionDefinition : public Expression {
@@ -100,6 +145,11 @@ public:
         return std::move(Declaration);
     }
 
+    // only until the declaration has been taken
+    std::string GetName() {
+        return Declaration->GetName();
+    }
+
     Expression &GetImplementation() {
         return *Implementation;
     }
@@ -186,19 +236,32 @@ public:
     }
 };
 
+// What a loop evaluates to: 0, or the sum, product, minimum or maximum of the values of its body
+enum class Reduction {
+    None,
+    Sum,
+    Product,
+    Min,
+    Max,
+};
+
 class LoopExpression : public Expression {
     std::string VariableName;
     std::unique_ptr<Expression> Let;
     std::unique_ptr<Expression> While;
     std::unique_ptr<Expression> Step;
     std::unique_ptr<Expression> Body;
+    // iterations run concurrently (`parallel while`)
+    bool Parallel;
+    enum Reduction Reduction;
 
 public:
     LoopExpression(std::string VariableName, std::unique_ptr<Expression> Let,
                    std::unique_ptr<Expression> While, std::unique_ptr<Expression> Step,
-                   std::unique_ptr<Expression> Body)
+                   std::unique_ptr<Expression> Body, bool Parallel = false,
+                   enum Reduction Reduction = Reduction::None)
             : VariableName(std::move(VariableName)), Let(std::move(Let)), While(std::move(While)),
-              Step(std::move(Step)), Body(std::move(Body)) {}
+              Step(std::move(Step)), Body(std::move(Body)), Parallel(Parallel), Reduction(Reduction) {}
 
     void Accept(ExpressionVisitor &Visitor) override;
 
@@ -225,6 +288,39 @@ public:
     bool HasStep() {
         return static_cast<bool>(Step);
     }
+
+    // The end of a loop whose condition is `<variable> < <end>`, whose number of iterations can be computed upfront.
+    // Nothing for other conditions.
+    Expression *GetCountedEnd();
+
+    bool IsParallel() const {
+        return Parallel;
+    }
+
+    enum Reduction GetReduction() const {
+        return Reduction;
+    }
+};
+
+// `spawn f(...)` runs a call next to the caller, the variable it's assigned to holds its result after `sync`
+class SpawnExpression : public Expression {
+    std::unique_ptr<FunctionCall> Call;
+
+public:
+    explicit SpawnExpression(std::unique_ptr<FunctionCall> Call) : Call(std::move(Call)) {}
+
+    void Accept(ExpressionVisitor &Visitor) override;
+
+    FunctionCall &GetCall() {
+        return *Call;
+    }
+};
+
+// `sync` waits for the calls spawned by the current function call
+class SyncExpression : public Expression {
+
+public:
+    void Accept(ExpressionVisitor &Visitor) override;
 };
 
 #endif
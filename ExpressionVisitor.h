@@ -21,6 +21,14 @@ class ConditionalExpression;
 
 class LoopExpression;
 
+class SpawnExpression;
+
+class SyncExpression;
+
+enum class Reduction;
+
+enum class NativeType;
+
 class ExpressionVisitor {
 
 public:
@@ -46,6 +54,10 @@ public:
 
     virtual void Visit(LoopExpression &Expression) = 0;
 
+    virtual void Visit(SpawnExpression &Expression) = 0;
+
+    virtual void Visit(SyncExpression &Expression) = 0;
+
     virtual void Register(std::unique_ptr<FunctionDeclaration> Declaration) = 0;
 };
 
@@ -1,15 +1,24 @@
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/Function.h>
+#include "CompileStats.h"
 #include "IRGenerator.h"
 #include "Expression.h"
+#include "MathBuiltIns.h"
 
 Function *IRGenerator::LookupFunction(std::string Name) {
+    // math built-ins are intrinsics, unless a function of the same name has been defined
+    auto Declaration = FunctionDeclarations.find(Name);
+    if (Declaration == FunctionDeclarations.end() ||
+        (Declaration->second->IsNative() && !Declaration->second->IsTyped())) {
+        if (const MathBuiltIn *Math = GetMathBuiltIn(Name))
+            return Intrinsic::getDeclaration(&Module, Math->Intrinsic, {Type::getDoubleTy(Context)});
+    }
+
     auto *ModuleFunction = Module.getFunction(Name);
     if (ModuleFunction) {
         return ModuleFunction;
     }
 
-    auto Declaration = FunctionDeclarations.find(Name);
     if (Declaration != FunctionDeclarations.end()) {
         Declaration->second->Accept(*this);
         return static_cast<class Function *>(Current);
@@ -27,6 +36,8 @@ void IRGenerator::Visit(VariableExpression &Expression) {
     AllocaInst *Alloca = ValuesByName[Expression.GetName()];
     if (!Alloca) {
         LogError("Variable unknown");
+        Current = nullptr;
+        return;
     }
 
     Current = Builder.CreateLoad(Alloca->getAllocatedType(), Alloca, Expression.GetName().c_str());
@@ -40,6 +51,20 @@ void IRGenerator::Visit(VariableDefinition &Expression) {
         const auto &VariableName = Variable.first;
         auto VariableInitializer = Variable.second.get();
 
+        // the spawned call stores its result to the variable
+        if (auto *Spawn = dynamic_cast<SpawnExpression *>(VariableInitializer)) {
+            AllocaInst *Alloca = CreateAlloca(Func, VariableName);
+            Builder.CreateStore(ConstantFP::get(Context, APFloat(0.0)), Alloca);
+            if (!GenerateSpawn(*Spawn, Alloca)) {
+                Current = nullptr;
+                return;
+            }
+
+            OriginalValues.push_back(ValuesByName[VariableName]);
+            ValuesByName[VariableName] = Alloca;
+            continue;
+        }
+
         Value *Initializer;
         if (VariableInitializer) {
             VariableInitializer->Accept(*this);
@@ -77,15 +102,26 @@ void IRGenerator::Visit(VariableDefinition &Expression) {
 }
 
 void IRGenerator::Visit(FunctionCall &Expression) {
+    unsigned n = Expression.GetArguments().size();
+
+    // before looking the function up, which declares it in the module
+    auto Declaration = FunctionDeclarations.find(Expression.GetName());
+    if (Declaration != FunctionDeclarations.end() && Declaration->second->GetArguments().size() != n) {
+        LogError("Invalid number of arguments passed to function");
+        Current = nullptr;
+        return;
+    }
+
     Function *Function = LookupFunction(Expression.GetName());
     if (!Function) {
         LogError("Calling unknown function");
+        Current = nullptr;
         return;
     }
 
-    unsigned n = Expression.GetArguments().size();
     if (Function->arg_size() != n) {
         LogError("Invalid number of arguments passed to function");
+        Current = nullptr;
         return;
     }
 
@@ -99,14 +135,72 @@ void IRGenerator::Visit(FunctionCall &Expression) {
         }
     }
 
-    Current = Builder.CreateCall(Function, ArgumentValues, "calltmp");
+    CallInst *Call = CreateNativeCall(Builder, Function, ArgumentValues);
+    // a function that replaces a math built-in isn't the C library's
+    if (!Function->isIntrinsic() && GetMathBuiltIn(Expression.GetName()))
+        Call->addFnAttr(Attribute::NoBuiltin);
+    Current = ConvertFromNative(Builder, Call);
+}
+
+Type *IRGenerator::GetNativeType(NativeType Native) {
+    switch (Native) {
+        case NativeType::F64:
+            return Type::getDoubleTy(Context);
+        case NativeType::F32:
+            return Type::getFloatTy(Context);
+        case NativeType::I64:
+            return Type::getInt64Ty(Context);
+        case NativeType::I32:
+            return Type::getInt32Ty(Context);
+        case NativeType::Ptr:
+            return Type::getInt8PtrTy(Context);
+        case NativeType::Void:
+            return Type::getVoidTy(Context);
+    }
+    return nullptr;
+}
+
+// integers are signed, pointers are their address
+Value *IRGenerator::ConvertToNative(IRBuilderBase &Builder, Value *Argument, Type *ArgumentType) {
+    if (ArgumentType->isDoubleTy())
+        return Argument;
+    if (ArgumentType->isFloatTy())
+        return Builder.CreateFPTrunc(Argument, ArgumentType);
+    if (ArgumentType->isIntegerTy())
+        return Builder.CreateFPToSI(Argument, ArgumentType);
+    return Builder.CreateIntToPtr(Builder.CreateFPToUI(Argument, Type::getInt64Ty(Context)), ArgumentType);
+}
+
+Value *IRGenerator::ConvertFromNative(IRBuilderBase &Builder, Value *Result) {
+    Type *ResultType = Result->getType();
+    if (ResultType->isDoubleTy())
+        return Result;
+    if (ResultType->isVoidTy())
+        return ConstantFP::get(Context, APFloat(0.0));
+    if (ResultType->isFloatTy())
+        return Builder.CreateFPExt(Result, Type::getDoubleTy(Context));
+    if (ResultType->isIntegerTy())
+        return Builder.CreateSIToFP(Result, Type::getDoubleTy(Context));
+    return Builder.CreateUIToFP(Builder.CreatePtrToInt(Result, Type::getInt64Ty(Context)), Type::getDoubleTy(Context));
+}
+
+CallInst *IRGenerator::CreateNativeCall(IRBuilderBase &Builder, Function *Callee, ArrayRef<Value *> Arguments) {
+    std::vector<Value *> Converted;
+    for (unsigned i = 0; i < Arguments.size(); ++i)
+        Converted.push_back(ConvertToNative(Builder, Arguments[i], Callee->getArg(i)->getType()));
+
+    // void values have no name
+    bool Void = Callee->getReturnType()->isVoidTy();
+    return Builder.CreateCall(Callee, Converted, Void ? "" : "calltmp");
 }
 
 void IRGenerator::Visit(FunctionDeclaration &Expression) {
     unsigned n = Expression.GetArguments().size();
-    std::vector<Type *> Doubles(n, Type::getDoubleTy(Context));
+    std::vector<Type *> ArgumentTypes;
+    for (unsigned i = 0; i < n; ++i)
+        ArgumentTypes.push_back(GetNativeType(Expression.GetArgumentType(i)));
 
-    FunctionType *FuncType = FunctionType::get(Type::getDoubleTy(Context), Doubles, false);
+    FunctionType *FuncType = FunctionType::get(GetNativeType(Expression.GetReturnType()), ArgumentTypes, false);
 
     Function *Func = Function::Create(FuncType, Function::ExternalLinkage, Expression.GetName(), Module);
 
@@ -119,6 +213,7 @@ void IRGenerator::Visit(FunctionDeclaration &Expression) {
 }
 
 void IRGenerator::Visit(FunctionDefinition &Expression) {
+    PhaseTimer Timer(Phase::IRGeneration);
     auto Declaration = Expression.TakeDeclaration();
     auto Name = Declaration->GetName();
     FunctionDeclarations[Name] = std::move(Declaration);
@@ -133,6 +228,7 @@ void IRGenerator::Visit(FunctionDefinition &Expression) {
     Builder.SetInsertPoint(Block);
 
     ValuesByName.clear();
+    TaskGroup = nullptr;
     for (auto &Argument: Func->args()) {
         AllocaInst *Alloca = CreateAlloca(Func, Argument.getName());
         Builder.CreateStore(&Argument, Alloca);
@@ -141,14 +237,18 @@ void IRGenerator::Visit(FunctionDefinition &Expression) {
 
     Expression.GetImplementation().Accept(*this);
     if (Value *ReturnValue = Current) {
+        // spawned calls finish before their caller returns
+        GenerateSync();
         Builder.CreateRet(ReturnValue);
 
         verifyFunction(*Func);
 
         if (PassManager) {
+            PhaseTimer Timer(Phase::FunctionPasses);
             PassManager->run(*Func);
         }
 
+        CountFunction();
         Current = Func;
         return;
     }
@@ -157,6 +257,44 @@ void IRGenerator::Visit(FunctionDefinition &Expression) {
     Current = nullptr;
 }
 
+Function *IRGenerator::Specialize(const std::string &Name, const std::vector<std::string> &Arguments,
+                                  const std::map<unsigned, double> &Constants, Expression &Body) {
+    std::vector<Type *> Doubles(Arguments.size() - Constants.size(), Type::getDoubleTy(Context));
+    FunctionType *FuncType = FunctionType::get(Type::getDoubleTy(Context), Doubles, false);
+    Function *Func = Function::Create(FuncType, Function::ExternalLinkage, Name, Module);
+
+    BasicBlock *Block = BasicBlock::Create(Context, "entry", Func);
+    Builder.SetInsertPoint(Block);
+
+    ValuesByName.clear();
+    TaskGroup = nullptr;
+    auto Argument = Func->arg_begin();
+    for (unsigned i = 0; i < Arguments.size(); ++i) {
+        AllocaInst *Alloca = CreateAlloca(Func, Arguments[i]);
+
+        auto Constant = Constants.find(i);
+        if (Constant != Constants.end()) {
+            Builder.CreateStore(ConstantFP::get(Context, APFloat(Constant->second)), Alloca);
+        } else {
+            Argument->setName(Arguments[i]);
+            Builder.CreateStore(&*Argument++, Alloca);
+        }
+
+        ValuesByName[Arguments[i]] = Alloca;
+    }
+
+    Body.Accept(*this);
+    if (Value *ReturnValue = Current) {
+        GenerateSync();
+        Builder.CreateRet(ReturnValue);
+        verifyFunction(*Func);
+        return Func;
+    }
+
+    Func->eraseFromParent();
+    return nullptr;
+}
+
 void IRGenerator::Visit(UnaryExpression &Expression) {
     Expression.GetOperand().Accept(*this);
     Value *Operand = Current;
@@ -179,6 +317,19 @@ void IRGenerator::Visit(BinaryExpression &Expression) {
     if (Expression.GetOperator() == '=') {
         auto &LeftSide = dynamic_cast<VariableExpression &>(Expression.GetLeftSide());
 
+        // the spawned call stores its result to the variable, the assignment evaluates to 0
+        if (auto *Spawn = dynamic_cast<SpawnExpression *>(&Expression.GetRightSide())) {
+            AllocaInst *Variable = ValuesByName[LeftSide.GetName()];
+            if (!Variable) {
+                LogError("Variable unknown");
+                Current = nullptr;
+                return;
+            }
+
+            Current = GenerateSpawn(*Spawn, Variable) ? ConstantFP::get(Context, APFloat(0.0)) : nullptr;
+            return;
+        }
+
         Expression.GetRightSide().Accept(*this);
         Value *RightSide = Current;
         if (!RightSide) {
@@ -301,6 +452,16 @@ void IRGenerator::Visit(ConditionalExpression &Expression) {
 }
 
 void IRGenerator::Visit(LoopExpression &Expression) {
+    if (Expression.IsParallel()) {
+        GenerateParallelLoop(Expression);
+        return;
+    }
+
+    if (Expression.GetReduction() != Reduction::None && Expression.GetCountedEnd()) {
+        GenerateCountedReduction(Expression);
+        return;
+    }
+
     std::string VariableName = Expression.GetVariableName();
     Function *Func = Builder.GetInsertBlock()->getParent();
     AllocaInst *Alloca = CreateAlloca(Func, VariableName);
@@ -315,6 +476,12 @@ void IRGenerator::Visit(LoopExpression &Expression) {
 
     Builder.CreateStore(Let, Alloca);
 
+    AllocaInst *Accumulator = nullptr;
+    if (Expression.GetReduction() != Reduction::None) {
+        Accumulator = CreateAlloca(Func, "acc");
+        Builder.CreateStore(GetReductionIdentity(Expression.GetReduction()), Accumulator);
+    }
+
     BasicBlock *LoopBlock = BasicBlock::Create(Context, "loop", Func);
 
     // fall through from current block to loop block
@@ -332,6 +499,11 @@ void IRGenerator::Visit(LoopExpression &Expression) {
         return;
     }
 
+    if (Accumulator) {
+        Value *Accumulated = Builder.CreateLoad(Accumulator->getAllocatedType(), Accumulator, "acc");
+        Builder.CreateStore(CreateReduction(Expression.GetReduction(), Accumulated, Current), Accumulator);
+    }
+
     // emit step:
     Value *Step;
     if (Expression.HasStep()) {
@@ -372,10 +544,389 @@ void IRGenerator::Visit(LoopExpression &Expression) {
         ValuesByName.erase(VariableName);
     }
 
+    if (Accumulator) {
+        Current = Builder.CreateLoad(Accumulator->getAllocatedType(), Accumulator, "reduction");
+        return;
+    }
+
     // return 0 always
     Current = Constant::getNullValue(Type::getDoubleTy(Context));
 }
 
+// Reductions over `<variable> < <end>` count their iterations with an integer, which gives the loop vectorizer an
+// induction variable and a trip count. Like in parallel loops, start, end and step are evaluated once and the variable
+// is computed from the iteration's index.
+void IRGenerator::GenerateCountedReduction(LoopExpression &Expression) {
+    std::string VariableName = Expression.GetVariableName();
+    Function *Func = Builder.GetInsertBlock()->getParent();
+
+    // emit start, end and step:
+    Expression.GetLet().Accept(*this);
+    Value *Start = Current;
+    if (!Start) {
+        Current = nullptr;
+        return;
+    }
+
+    Expression.GetCountedEnd()->Accept(*this);
+    Value *End = Current;
+    if (!End) {
+        Current = nullptr;
+        return;
+    }
+
+    Value *Step = ConstantFP::get(Context, APFloat(1.0));
+    if (Expression.HasStep()) {
+        Expression.GetStep().Accept(*this);
+        Step = Current;
+        if (!Step) {
+            Current = nullptr;
+            return;
+        }
+    }
+
+    // like `while`, which checks the condition after the body with the variable's value before the step
+    Type *Int64 = Type::getInt64Ty(Context);
+    Value *Steps = Builder.CreateUnaryIntrinsic(
+            Intrinsic::ceil, Builder.CreateFDiv(Builder.CreateFSub(End, Start), Step), nullptr, "steps");
+    Value *Counted = Builder.CreateAnd(Builder.CreateFCmpOLT(Start, End),
+                                      Builder.CreateFCmpOGT(Step, ConstantFP::get(Context, APFloat(0.0))));
+    Value *Iterations = Builder.CreateSelect(
+            Counted, Builder.CreateAdd(Builder.CreateFPToSI(Steps, Int64), ConstantInt::get(Int64, 1)),
+            ConstantInt::get(Int64, 1), "iterations");
+
+    // infinite ranges and steps, tiny steps and NaN (inf / inf) can't be counted (nor computed from the index, 0 * inf
+    // is NaN): those loops step the variable like `while`
+    Value *Infinity = ConstantFP::getInfinity(Type::getDoubleTy(Context));
+    Value *Countable = Builder.CreateAnd(
+            Builder.CreateFCmpOLT(Builder.CreateUnaryIntrinsic(Intrinsic::fabs, Steps),
+                                  ConstantFP::get(Context, APFloat((double) (1ull << 62)))),
+            Builder.CreateFCmpOLT(Step, Infinity));
+    Value *Stepped = Builder.CreateAnd(Counted, Builder.CreateNot(Countable), "stepped");
+
+    AllocaInst *Alloca = CreateAlloca(Func, VariableName);
+    AllocaInst *Accumulator = CreateAlloca(Func, "acc");
+    Builder.CreateStore(GetReductionIdentity(Expression.GetReduction()), Accumulator);
+
+    BasicBlock *EntryBlock = Builder.GetInsertBlock();
+    BasicBlock *LoopBlock = BasicBlock::Create(Context, "loop", Func);
+    BasicBlock *SteppedBlock = BasicBlock::Create(Context, "steppedloop");
+    BasicBlock *AfterBlock = BasicBlock::Create(Context, "afterloop");
+    Builder.CreateCondBr(Stepped, SteppedBlock, LoopBlock);
+    Builder.SetInsertPoint(LoopBlock);
+
+    PHINode *Index = Builder.CreatePHI(Int64, 2, "index");
+    Index->addIncoming(ConstantInt::get(Int64, 0), EntryBlock);
+
+    Value *Variable = Builder.CreateFAdd(
+            Start, Builder.CreateFMul(Builder.CreateSIToFP(Index, Type::getDoubleTy(Context)), Step), VariableName);
+    Builder.CreateStore(Variable, Alloca);
+
+    AllocaInst *OriginalValue = ValuesByName[VariableName];
+    ValuesByName[VariableName] = Alloca;
+
+    // emit loop body:
+    Expression.GetBody().Accept(*this);
+    if (!Current) {
+        Current = nullptr;
+        return;
+    }
+
+    Value *Accumulated = Builder.CreateLoad(Accumulator->getAllocatedType(), Accumulator, "acc");
+    Builder.CreateStore(CreateReduction(Expression.GetReduction(), Accumulated, Current), Accumulator);
+
+    // the body may have added blocks
+    Value *NextIndex = Builder.CreateAdd(Index, ConstantInt::get(Int64, 1), "nextindex");
+    Index->addIncoming(NextIndex, Builder.GetInsertBlock());
+    Builder.CreateCondBr(Builder.CreateICmpULT(NextIndex, Iterations, "loopcond"), LoopBlock, AfterBlock);
+
+    // the loop that can't be counted, with a copy of the body
+    SteppedBlock->insertInto(Func);
+    Builder.SetInsertPoint(SteppedBlock);
+    PHINode *SteppedVariable = Builder.CreatePHI(Type::getDoubleTy(Context), 2, VariableName);
+    SteppedVariable->addIncoming(Start, EntryBlock);
+    Builder.CreateStore(SteppedVariable, Alloca);
+
+    Expression.GetBody().Accept(*this);
+    if (!Current) {
+        Current = nullptr;
+        return;
+    }
+
+    Accumulated = Builder.CreateLoad(Accumulator->getAllocatedType(), Accumulator, "acc");
+    Builder.CreateStore(CreateReduction(Expression.GetReduction(), Accumulated, Current), Accumulator);
+
+    SteppedVariable->addIncoming(Builder.CreateFAdd(SteppedVariable, Step, "nextvar"), Builder.GetInsertBlock());
+    Builder.CreateCondBr(Builder.CreateFCmpOLT(SteppedVariable, End, "loopcond"), SteppedBlock, AfterBlock);
+
+    AfterBlock->insertInto(Func);
+    Builder.SetInsertPoint(AfterBlock);
+
+    if (OriginalValue) {
+        ValuesByName[VariableName] = OriginalValue;
+    } else {
+        ValuesByName.erase(VariableName);
+    }
+
+    Current = Builder.CreateLoad(Accumulator->getAllocatedType(), Accumulator, "reduction");
+}
+
+AllocaInst *IRGenerator::GetTaskGroup(Function *Func) {
+    if (!TaskGroup) {
+        IRBuilder<> EntryBuilder(&Func->getEntryBlock(), Func->getEntryBlock().begin());
+        TaskGroup = EntryBuilder.CreateAlloca(Type::getInt64Ty(Context), nullptr, "tasks");
+        EntryBuilder.CreateStore(ConstantInt::get(Type::getInt64Ty(Context), 0), TaskGroup);
+    }
+    return TaskGroup;
+}
+
+// The arguments are evaluated by the caller and copied by the runtime, which calls `<callee>.spawn(arguments, result)`
+// on a worker thread or right away.
+bool IRGenerator::GenerateSpawn(SpawnExpression &Expression, AllocaInst *Result) {
+    auto &Call = Expression.GetCall();
+    Function *Callee = LookupFunction(Call.GetName());
+    if (!Callee) {
+        LogError("Calling unknown function");
+        return false;
+    }
+
+    unsigned n = Call.GetArguments().size();
+    if (Callee->arg_size() != n) {
+        LogError("Invalid number of arguments passed to function");
+        return false;
+    }
+
+    Function *Func = Builder.GetInsertBlock()->getParent();
+    ArrayType *ArgumentsType = ArrayType::get(Type::getDoubleTy(Context), n);
+    IRBuilder<> EntryBuilder(&Func->getEntryBlock(), Func->getEntryBlock().begin());
+    AllocaInst *Arguments = EntryBuilder.CreateAlloca(ArgumentsType, nullptr, "arguments");
+
+    for (unsigned i = 0; i < n; ++i) {
+        Call.GetArguments()[i]->Accept(*this);
+        if (!Current)
+            return false;
+        Builder.CreateStore(Current, Builder.CreateConstInBoundsGEP2_32(ArgumentsType, Arguments, 0, i));
+    }
+
+    Type *DoublePtr = Type::getDoublePtrTy(Context);
+    Function *Spawned = GetSpawnedCall(Call.GetName(), Callee);
+    FunctionCallee Runtime = Module.getOrInsertFunction(
+            "__solid_spawn",
+            FunctionType::get(Type::getVoidTy(Context),
+                              {Type::getInt64PtrTy(Context), Spawned->getType(), DoublePtr,
+                               Type::getInt32Ty(Context), DoublePtr}, false));
+    Value *ResultPointer = Result ? static_cast<Value *>(Result) : ConstantPointerNull::get(
+            cast<PointerType>(DoublePtr));
+    Builder.CreateCall(Runtime, {GetTaskGroup(Func), Spawned,
+                                 Builder.CreateConstInBoundsGEP2_32(ArgumentsType, Arguments, 0, 0),
+                                 ConstantInt::get(Type::getInt32Ty(Context), n), ResultPointer});
+    return true;
+}
+
+// named after the call, the callee may be an intrinsic
+Function *IRGenerator::GetSpawnedCall(const std::string &CallName, Function *Callee) {
+    std::string Name = CallName + ".spawn";
+    if (Function *Existing = Module.getFunction(Name))
+        return Existing;
+
+    Type *DoublePtr = Type::getDoublePtrTy(Context);
+    FunctionType *SpawnedType = FunctionType::get(Type::getVoidTy(Context), {DoublePtr, DoublePtr}, false);
+    Function *Spawned = Function::Create(SpawnedType, Function::InternalLinkage, Name, Module);
+
+    IRBuilder<> SpawnedBuilder(BasicBlock::Create(Context, "entry", Spawned));
+    std::vector<Value *> Arguments;
+    for (unsigned i = 0; i < Callee->arg_size(); ++i) {
+        Value *Argument = SpawnedBuilder.CreateConstInBoundsGEP1_32(Type::getDoubleTy(Context), Spawned->getArg(0), i);
+        Arguments.push_back(SpawnedBuilder.CreateLoad(Type::getDoubleTy(Context), Argument));
+    }
+    SpawnedBuilder.CreateStore(ConvertFromNative(SpawnedBuilder, CreateNativeCall(SpawnedBuilder, Callee, Arguments)),
+                               Spawned->getArg(1));
+    SpawnedBuilder.CreateRetVoid();
+
+    verifyFunction(*Spawned);
+    return Spawned;
+}
+
+void IRGenerator::GenerateSync() {
+    if (!TaskGroup)
+        return;
+
+    FunctionCallee Runtime = Module.getOrInsertFunction(
+            "__solid_sync",
+            FunctionType::get(Type::getVoidTy(Context), {Type::getInt64PtrTy(Context)}, false));
+    Builder.CreateCall(Runtime, {TaskGroup});
+}
+
+void IRGenerator::Visit(SpawnExpression &Expression) {
+    // nothing keeps the result
+    Current = GenerateSpawn(Expression, nullptr) ? ConstantFP::get(Context, APFloat(0.0)) : nullptr;
+}
+
+void IRGenerator::Visit(SyncExpression &Expression) {
+    GetTaskGroup(Builder.GetInsertBlock()->getParent());
+    GenerateSync();
+    Current = ConstantFP::get(Context, APFloat(0.0));
+}
+
+Constant *IRGenerator::GetReductionIdentity(enum Reduction Reduction) {
+    switch (Reduction) {
+        case Reduction::Product:
+            return ConstantFP::get(Context, APFloat(1.0));
+        case Reduction::Min:
+            return ConstantFP::getInfinity(Type::getDoubleTy(Context));
+        case Reduction::Max:
+            return ConstantFP::getInfinity(Type::getDoubleTy(Context), true);
+        default:
+            return ConstantFP::get(Context, APFloat(0.0));
+    }
+}
+
+// Only the reduction may be reassociated, which lets the loop vectorizer keep partial results per lane.
+// Everything else in the loop keeps strict floating point semantics.
+Value *IRGenerator::CreateReduction(enum Reduction Reduction, Value *Accumulated, Value *Next) {
+    Value *Result;
+    switch (Reduction) {
+        case Reduction::Product:
+            Result = Builder.CreateFMul(Accumulated, Next, "product");
+            break;
+        case Reduction::Min:
+            Result = Builder.CreateMinNum(Accumulated, Next, "min");
+            break;
+        case Reduction::Max:
+            Result = Builder.CreateMaxNum(Accumulated, Next, "max");
+            break;
+        default:
+            Result = Builder.CreateFAdd(Accumulated, Next, "sum");
+            break;
+    }
+
+    if (auto *Instruction = dyn_cast<class Instruction>(Result)) {
+        FastMathFlags Flags;
+        Flags.setAllowReassoc();
+        Instruction->setFastMathFlags(Flags);
+    }
+    return Result;
+}
+
+// The body of a parallel loop is outlined into `<function>.parallel(captures, index)`, which the runtime calls on its
+// worker threads. Iterations get copies of the variables in scope, so assignments to them don't leave the iteration.
+void IRGenerator::GenerateParallelLoop(LoopExpression &Expression) {
+    std::string VariableName = Expression.GetVariableName();
+
+    class Expression *CountedEnd = Expression.GetCountedEnd();
+    if (!CountedEnd) {
+        LogError("Condition of a parallel loop must compare its variable with '<'");
+        Current = nullptr;
+        return;
+    }
+
+    // emit start, end and step (evaluated once, before the iterations):
+    Expression.GetLet().Accept(*this);
+    Value *Start = Current;
+    if (!Start) {
+        Current = nullptr;
+        return;
+    }
+
+    CountedEnd->Accept(*this);
+    Value *End = Current;
+    if (!End) {
+        Current = nullptr;
+        return;
+    }
+
+    Value *Step = ConstantFP::get(Context, APFloat(1.0));
+    if (Expression.HasStep()) {
+        Expression.GetStep().Accept(*this);
+        Step = Current;
+        if (!Step) {
+            Current = nullptr;
+            return;
+        }
+    }
+
+    // emit captures:
+    Function *Func = Builder.GetInsertBlock()->getParent();
+    std::vector<std::pair<std::string, AllocaInst *>> Captured;
+    for (auto &Entry: ValuesByName) {
+        if (Entry.second && Entry.first != VariableName)
+            Captured.emplace_back(Entry.first, Entry.second);
+    }
+
+    ArrayType *CapturesType = ArrayType::get(Type::getDoubleTy(Context), Captured.size());
+    IRBuilder<> EntryBuilder(&Func->getEntryBlock(), Func->getEntryBlock().begin());
+    AllocaInst *Captures = EntryBuilder.CreateAlloca(CapturesType, nullptr, "captures");
+
+    for (unsigned i = 0; i < Captured.size(); ++i) {
+        Value *CapturedValue = Builder.CreateLoad(Type::getDoubleTy(Context), Captured[i].second, Captured[i].first);
+        Builder.CreateStore(CapturedValue, Builder.CreateConstInBoundsGEP2_32(CapturesType, Captures, 0, i));
+    }
+
+    // emit body function:
+    Type *Int8Ptr = Type::getInt8PtrTy(Context);
+    FunctionType *BodyType = FunctionType::get(Type::getVoidTy(Context), {Int8Ptr, Type::getDoubleTy(Context)}, false);
+    Function *Body = Function::Create(BodyType, Function::InternalLinkage, Func->getName() + ".parallel", Module);
+
+    auto OuterValuesByName = ValuesByName;
+    AllocaInst *OuterTaskGroup = TaskGroup;
+    TaskGroup = nullptr;
+    bool BodyFailed;
+    {
+        IRBuilderBase::InsertPointGuard Guard(Builder);
+        Builder.SetInsertPoint(BasicBlock::Create(Context, "entry", Body));
+
+        ValuesByName.clear();
+        Value *BodyCaptures = Builder.CreateBitCast(Body->getArg(0), CapturesType->getPointerTo(), "captures");
+        for (unsigned i = 0; i < Captured.size(); ++i) {
+            auto &Name = Captured[i].first;
+            Value *CapturedValue = Builder.CreateLoad(Type::getDoubleTy(Context),
+                                               Builder.CreateConstInBoundsGEP2_32(CapturesType, BodyCaptures, 0, i),
+                                               Name);
+            AllocaInst *Alloca = CreateAlloca(Body, Name);
+            Builder.CreateStore(CapturedValue, Alloca);
+            ValuesByName[Name] = Alloca;
+        }
+
+        Argument *Index = Body->getArg(1);
+        Index->setName(VariableName);
+        AllocaInst *IndexAlloca = CreateAlloca(Body, VariableName);
+        Builder.CreateStore(Index, IndexAlloca);
+        ValuesByName[VariableName] = IndexAlloca;
+
+        Expression.GetBody().Accept(*this);
+        BodyFailed = !Current;
+        if (!BodyFailed) {
+            GenerateSync();
+            Builder.CreateRetVoid();
+        }
+    }
+    ValuesByName = OuterValuesByName;
+    TaskGroup = OuterTaskGroup;
+
+    if (BodyFailed) {
+        Body->eraseFromParent();
+        Current = nullptr;
+        return;
+    }
+
+    verifyFunction(*Body);
+    if (PassManager) {
+        PhaseTimer Timer(Phase::FunctionPasses);
+        PassManager->run(*Body);
+    }
+
+    // emit runtime call:
+    FunctionCallee Runtime = Module.getOrInsertFunction(
+            "__solid_parallel_while",
+            FunctionType::get(Type::getVoidTy(Context),
+                              {Type::getDoubleTy(Context), Type::getDoubleTy(Context), Type::getDoubleTy(Context),
+                               BodyType->getPointerTo(), Int8Ptr}, false));
+    Builder.CreateCall(Runtime, {Start, End, Step, Body, Builder.CreateBitCast(Captures, Int8Ptr)});
+
+    // return 0 always, like sequential loops
+    Current = Constant::getNullValue(Type::getDoubleTy(Context));
+}
+
 void IRGenerator::Register(std::unique_ptr<FunctionDeclaration> Declaration) {
     FunctionDeclarations[Declaration->GetName()] = std::move(Declaration);
 }
@@ -430,6 +981,16 @@ void IRPrinter::Visit(LoopExpression &Expression) {
     Print();
 }
 
+void IRPrinter::Visit(SpawnExpression &Expression) {
+    IRGenerator->Visit(Expression);
+    Print();
+}
+
+void IRPrinter::Visit(SyncExpression &Expression) {
+    IRGenerator->Visit(Expression);
+    Print();
+}
+
 void IRPrinter::Register(std::unique_ptr<FunctionDeclaration> Declaration) {
     IRGenerator->Register(std::move(Declaration));
 }
@@ -7,11 +7,15 @@
 #include <llvm/IR/LegacyPassManager.h>
 #include <map>
 #include <utility>
+#include <vector>
 
+#include "ErrorHandler.h"
 #include "ExpressionVisitor.h"
 
 using namespace llvm;
 
+class Expression;
+
 class IRGenerator : public ExpressionVisitor {
     LLVMContext &Context;
 
@@ -25,19 +29,53 @@ class IRGenerator : public ExpressionVisitor {
 
     std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations;
 
+    ErrorHandler OnError;
+
     Value *Current;
 
+    // counter of the calls spawned by the function being generated, created by its first `spawn` or `sync`
+    AllocaInst *TaskGroup = nullptr;
+
     Function *LookupFunction(std::string Name);
 
     AllocaInst *CreateAlloca(Function *Func, StringRef Name);
 
+    Type *GetNativeType(NativeType Native);
+
+    // Converts a double argument to the type a native expects
+    Value *ConvertToNative(IRBuilderBase &Builder, Value *Argument, Type *ArgumentType);
+
+    // Converts the result of a call to a double, void is 0
+    Value *ConvertFromNative(IRBuilderBase &Builder, Value *Result);
+
+    // Calls Callee with double arguments, converted to the types of its arguments
+    CallInst *CreateNativeCall(IRBuilderBase &Builder, Function *Callee, ArrayRef<Value *> Arguments);
+
+    void GenerateParallelLoop(LoopExpression &Expression);
+
+    void GenerateCountedReduction(LoopExpression &Expression);
+
+    AllocaInst *GetTaskGroup(Function *Func);
+
+    // Spawns the call, its result is stored to Result (if any). Returns false on errors.
+    bool GenerateSpawn(SpawnExpression &Expression, AllocaInst *Result);
+
+    Function *GetSpawnedCall(const std::string &CallName, Function *Callee);
+
+    void GenerateSync();
+
+    Constant *GetReductionIdentity(enum Reduction Reduction);
+
+    Value *CreateReduction(enum Reduction Reduction, Value *Accumulated, Value *Next);
+
 public:
     explicit IRGenerator(LLVMContext &Context, IRBuilder<> &Builder, class Module &Module,
                          std::unique_ptr<legacy::FunctionPassManager> PassManager,
                          std::map<std::string, AllocaInst *> &ValuesByName,
-                         std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations)
+                         std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations,
+                         ErrorHandler OnError = PrintError)
             : Context(Context), Builder(Builder), Module(Module), PassManager(std::move(PassManager)),
-              ValuesByName(ValuesByName), FunctionDeclarations(FunctionDeclarations) {}
+              ValuesByName(ValuesByName), FunctionDeclarations(FunctionDeclarations), OnError(std::move(OnError)) {}
 
     void Visit(VariableExpression &Expression) override;
 
@@ -59,14 +97,23 @@ public:
 
     void Visit(LoopExpression &Expression) override;
 
+    void Visit(SpawnExpression &Expression) override;
+
+    void Visit(SyncExpression &Expression) override;
+
     void Register(std::unique_ptr<FunctionDeclaration> Declaration) override;
 
+    // Generates Name from the body of a function with the given arguments, where the arguments in Constants
+    // (by index) are replaced by their values. The generated function takes the remaining arguments.
+    Function *Specialize(const std::string &Name, const std::vector<std::string> &Arguments,
+                         const std::map<unsigned, double> &Constants, Expression &Body);
+
     Value *GetValue() {
         return Current;
     }
 
     void LogError(const char *Message) {
-        fprintf(stderr, "Error: %s\n", Message);
+        OnError(Message);
     }
 };
 
@@ -104,6 +151,10 @@ public:
 
     void Visit(LoopExpression &Expression) override;
 
+    void Visit(SpawnExpression &Expression) override;
+
+    void Visit(SyncExpression &Expression) override;
+
     void Register(std::unique_ptr<FunctionDeclaration> Declaration) override;
 };
 
@@ -0,0 +1,216 @@
+#include "Interpreter.h"
+#include "MathBuiltIns.h"
+
+std::optional<double> Interpreter::Evaluate(FunctionDefinition &TopLevelExpression) {
+    auto &Body = TopLevelExpression.GetImplementation();
+
+    Checking = true;
+    Supported = true;
+    Body.Accept(*this);
+    ValuesByName.clear();
+
+    if (!Supported)
+        return std::nullopt;
+
+    Checking = false;
+    Body.Accept(*this);
+    ValuesByName.clear();
+
+    return Current;
+}
+
+bool Interpreter::Resolve(const std::string &Name, unsigned ArgumentCount) {
+    // leave unknown functions and wrong argument counts to the JIT, which reports them
+    auto Declaration = FunctionDeclarations.find(Name);
+    if (const MathBuiltIn *Math = GetMathBuiltIn(Name)) {
+        if (Declaration == FunctionDeclarations.end() ||
+            (Declaration->second->IsNative() && !Declaration->second->IsTyped())) {
+            if (Math->Arity != ArgumentCount)
+                return false;
+            Addresses[Name] = (JITTargetAddress) (uintptr_t) Math->Address;
+            return true;
+        }
+
+        // defined since, look up its stub
+        auto Address = Addresses.find(Name);
+        if (Address != Addresses.end() && Address->second == (JITTargetAddress) (uintptr_t) Math->Address)
+            Addresses.erase(Address);
+    }
+
+    if (Declaration == FunctionDeclarations.end() || Declaration->second->GetArguments().size() != ArgumentCount ||
+        ArgumentCount > MaxNativeArguments)
+        return false;
+
+    // calls of typed natives need conversions, which compiled code does
+    if (Declaration->second->IsTyped())
+        return false;
+
+    // redefined functions keep their address (the stub's)
+    if (Addresses.count(Name))
+        return true;
+
+    auto Symbol = JIT.Lookup(Name);
+    if (!Symbol) {
+        consumeError(Symbol.takeError());
+        return false;
+    }
+
+    Addresses[Name] = Symbol->getAddress();
+    return true;
+}
+
+void Interpreter::Call(const std::string &Name, ArrayRef<double> Arguments) {
+    if (Checking) {
+        if (!Resolve(Name, Arguments.size()))
+            Supported = false;
+        Current = 0;
+        return;
+    }
+
+    Current = CallNative(Addresses[Name], Arguments);
+}
+
+void Interpreter::Visit(VariableExpression &Expression) {
+    auto Value = ValuesByName.find(Expression.GetName());
+    if (Value == ValuesByName.end()) {
+        Supported = false;
+        Current = 0;
+        return;
+    }
+
+    Current = Value->second;
+}
+
+void Interpreter::Visit(VariableDefinition &Expression) {
+    std::vector<std::optional<double>> OriginalValues;
+
+    for (auto &Variable: Expression.GetVariables()) {
+        const auto &VariableName = Variable.first;
+
+        // use 0 without initializer
+        Current = 0;
+        if (Variable.second)
+            Variable.second->Accept(*this);
+
+        auto Original = ValuesByName.find(VariableName);
+        OriginalValues.push_back(Original != ValuesByName.end() ? std::optional<double>(Original->second)
+                                                                : std::nullopt);
+
+        ValuesByName[VariableName] = Current;
+    }
+
+    Expression.GetBody().Accept(*this);
+
+    unsigned n = Expression.GetVariables().size();
+    for (unsigned i = 0; i < n; ++i) {
+        const auto &VariableName = Expression.GetVariables()[i].first;
+        if (OriginalValues[i]) {
+            ValuesByName[VariableName] = *OriginalValues[i];
+        } else {
+            ValuesByName.erase(VariableName);
+        }
+    }
+}
+
+void Interpreter::Visit(FunctionCall &Expression) {
+    std::vector<double> ArgumentValues;
+    for (auto &Argument: Expression.GetArguments()) {
+        Argument->Accept(*this);
+        ArgumentValues.push_back(Current);
+    }
+
+    Call(Expression.GetName(), ArgumentValues);
+}
+
+void Interpreter::Visit(FunctionDeclaration &Expression) {
+    Supported = false;
+}
+
+void Interpreter::Visit(FunctionDefinition &Expression) {
+    Supported = false;
+}
+
+void Interpreter::Visit(UnaryExpression &Expression) {
+    Expression.GetOperand().Accept(*this);
+    Call(std::string("unary") + Expression.GetOperator(), Current);
+}
+
+void Interpreter::Visit(BinaryExpression &Expression) {
+    if (Expression.GetOperator() == '=') {
+        auto *LeftSide = dynamic_cast<VariableExpression *>(&Expression.GetLeftSide());
+        if (!LeftSide || !ValuesByName.count(LeftSide->GetName())) {
+            Supported = false;
+            return;
+        }
+
+        Expression.GetRightSide().Accept(*this);
+        ValuesByName[LeftSide->GetName()] = Current;
+        return;
+    }
+
+    Expression.GetLeftSide().Accept(*this);
+    double LeftSide = Current;
+    Expression.GetRightSide().Accept(*this);
+    double RightSide = Current;
+
+    // same semantics as the generated IR
+    switch (Expression.GetOperator()) {
+        case '+':
+            Current = LeftSide + RightSide;
+            return;
+        case '-':
+            Current = LeftSide - RightSide;
+            return;
+        case '*':
+            Current = LeftSide * RightSide;
+            return;
+        case '<':
+            // unordered or less than
+            Current = !(LeftSide >= RightSide) ? 1.0 : 0.0;
+            return;
+        default:
+            break;
+    }
+
+    Call(std::string("binary") + Expression.GetOperator(), {LeftSide, RightSide});
+}
+
+void Interpreter::Visit(NumExpression &Expression) {
+    Current = Expression.GetVal();
+}
+
+void Interpreter::Visit(ConditionalExpression &Expression) {
+    Expression.GetCondition().Accept(*this);
+    // ordered and not equal to 0
+    bool Condition = Current < 0.0 || Current > 0.0;
+
+    if (Checking) {
+        Expression.GetThen().Accept(*this);
+        Expression.GetOtherwise().Accept(*this);
+        return;
+    }
+
+    if (Condition) {
+        Expression.GetThen().Accept(*this);
+    } else {
+        Expression.GetOtherwise().Accept(*this);
+    }
+}
+
+void Interpreter::Visit(LoopExpression &Expression) {
+    // loops run much faster compiled
+    Supported = false;
+}
+
+void Interpreter::Visit(SpawnExpression &Expression) {
+    // spawned calls run compiled
+    Supported = false;
+}
+
+void Interpreter::Visit(SyncExpression &Expression) {
+    Supported = false;
+}
+
+void Interpreter::Register(std::unique_ptr<FunctionDeclaration> Declaration) {
+    FunctionDeclarations[Declaration->GetName()] = std::move(Declaration);
+}
@@ -0,0 +1,71 @@
+#ifndef SOLID_LANG_INTERPRETER_H
+#define SOLID_LANG_INTERPRETER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include <map>
+#include <optional>
+#include <string>
+#include "Expression.h"
+#include "ExpressionVisitor.h"
+#include "JIT.h"
+#include "NativeCall.h"
+
+using namespace llvm;
+
+// Evaluates REPL top level expressions directly on the AST, calling functions through their JIT'd addresses.
+// This skips building, optimizing, compiling and removing a module for every expression.
+// Expressions with loops or calls that can't be resolved are left to the JIT.
+class Interpreter : public ExpressionVisitor {
+    class JIT &JIT;
+
+    std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations;
+
+    std::map<std::string, JITTargetAddress> Addresses;
+
+    std::map<std::string, double> ValuesByName;
+
+    double Current = 0;
+
+    // first pass: only check that the expression can be interpreted, without calling anything
+    bool Checking = false;
+    bool Supported = true;
+
+    bool Resolve(const std::string &Name, unsigned ArgumentCount);
+
+    void Call(const std::string &Name, ArrayRef<double> Arguments);
+
+public:
+    Interpreter(class JIT &JIT, std::map<std::string, std::unique_ptr<FunctionDeclaration>> &FunctionDeclarations)
+            : JIT(JIT), FunctionDeclarations(FunctionDeclarations) {}
+
+    // Value of the top level expression, nothing if it has to be compiled
+    std::optional<double> Evaluate(FunctionDefinition &TopLevelExpression);
+
+    void Visit(VariableExpression &Expression) override;
+
+    void Visit(VariableDefinition &Expression) override;
+
+    void Visit(FunctionCall &Expression) override;
+
+    void Visit(FunctionDeclaration &Expression) override;
+
+    void Visit(FunctionDefinition &Expression) override;
+
+    void Visit(UnaryExpression &Expression) override;
+
+    void Visit(BinaryExpression &Expression) override;
+
+    void Visit(NumExpression &Expression) override;
+
+    void Visit(ConditionalExpression &Expression) override;
+
+    void Visit(LoopExpression &Expression) override;
+
+    void Visit(SpawnExpression &Expression) override;
+
+    void Visit(SyncExpression &Expression) override;
+
+    void Register(std::unique_ptr<FunctionDeclaration> Declaration) override;
+};
+
+#endif
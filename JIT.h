@@ -4,6 +4,8 @@
 #define SOLID_LANG_JIT_CPP
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
@@ -11,68 +13,244 @@
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include <llvm/Transforms/Utils.h>
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include "BuiltIns.h"
+#include "CompileCache.h"
+#include "CompileStats.h"
+#include "CountingMemoryManager.h"
+#include "MathBuiltIns.h"
+#include "Optimizer.h"
+#include "PerfProfiler.h"
+#include "RuntimeBitcode.h"
+#include "SlabMemoryManager.h"
+#include "ThreadPoolDispatcher.h"
+#include "TieredCompiler.h"
 
 using namespace llvm;
 using namespace llvm::orc;
 
+struct JITOptions {
+    // Compile functions with a light pass list first and re-optimize hot ones at O3 in the background
+    bool Tiered = false;
+
+    // Number of calls after which a function is re-optimized (0 does so on the first call, like 1)
+    unsigned TierUpThreshold = 1000;
+
+    // Directory for compiled objects that are reused across sessions (no caching if empty)
+    std::string CacheDirectory;
+
+    // Size of the cache directory above which the least recently used objects are evicted
+    uint64_t CacheSizeLimit = 512 * 1024 * 1024;
+
+    // Link with JITLink into slab allocated memory instead of RuntimeDyld with memory mapped per object
+    bool UseJITLink = false;
+
+    // Size of the memory mappings JITLink allocates code and data from
+    uint64_t SlabSize = 64 * 1024 * 1024;
+
+    // Number of threads that compile and link modules (0: one per hardware thread, 1: on the thread that looks them up)
+    unsigned CompileThreads = 0;
+
+    // Write /tmp/perf-<pid>.map so `perf report` can name JIT'd functions
+    bool PerfMap = false;
+
+    // Write a jitdump file with the JIT'd code for `perf inject --jit`
+    bool JitDump = false;
+
+    // Bytes of JIT'd code and data above which the least recently called functions are evicted (0: no limit)
+    uint64_t MemoryBudget = 0;
+
+    // Vector math library that loops optimized at O3 may call (tier 1 and specialized functions)
+    TargetLibraryInfoImpl::VectorLibrary VectorLibrary = TargetLibraryInfoImpl::NoLibrary;
+};
+
+// Times the machine code generation of the modules the JIT materializes
+class TimedIRCompiler : public IRCompileLayer::IRCompiler {
+    std::unique_ptr<IRCompiler> Compiler;
+
+public:
+    explicit TimedIRCompiler(std::unique_ptr<IRCompiler> Compiler)
+            : IRCompiler(Compiler->getManglingOptions()), Compiler(std::move(Compiler)) {}
+
+    Expected<std::unique_ptr<MemoryBuffer>> operator()(Module &Module) override {
+        PhaseTimer Timer(Phase::Materialization);
+        CountInstructions(Module);
+        return (*Compiler)(Module);
+    }
+};
+
+struct MemoryBudgetStats {
+    uint64_t Evictions = 0;
+    uint64_t Recompiles = 0;
+};
+
 class JIT {
 private:
     std::unique_ptr<ExecutionSession> ES;
 
+    JITTargetMachineBuilder JTMB;
     DataLayout DL;
     MangleAndInterner Mangle;
 
-    RTDyldObjectLinkingLayer ObjectLayer;
+    std::unique_ptr<JITObjectCache> Cache;
+
+    // owned by the object layer when JITLink is used
+    SlabMemoryManager *CodeMemory = nullptr;
+
+    // totals of the memory managers RuntimeDyld creates per object
+    CountingMemoryManager::Counter SectionMemory;
+
+    std::unique_ptr<PerfProfiler> Profiler;
+
+    std::unique_ptr<class ObjectLayer> ObjectLayer;
     IRCompileLayer CompileLayer;
     IRTransformLayer OptimizeLayer;
+    IRTransformLayer Tier1Layer;
 
     JITDylib &Main;
+    JITDylib &BuiltIns;
+
+    std::unique_ptr<TieredCompiler> Tiers;
+
+    // Functions added with AddFunctions are called through a stub `f` that points to the current version `f$v<n>`.
+    // With a memory budget, the code of a version can be evicted: its stub then points to `f$v<n>$recompile`,
+    // which adds the version again from its bitcode when it's called.
+    struct FunctionVersion {
+        unsigned Version = 0;
+        std::string Implementation;
+        // owns the code of the current version, null while it's evicted
+        ResourceTrackerSP Tracker;
+        // owns the recompile thunk of the current version
+        ResourceTrackerSP ThunkTracker;
+        SmallVector<char, 0> Bitcode;
+        // epoch of the last call, stored by the function when it's entered
+        std::atomic<uint64_t> LastCalled{0};
+    };
+
+    struct PendingVersion {
+        std::string Name;
+        std::string Implementation;
+        ResourceTrackerSP Tracker;
+        ResourceTrackerSP ThunkTracker;
+        SmallVector<char, 0> Bitcode;
+    };
+
+    std::unique_ptr<IndirectStubsManager> Stubs;
+    std::map<std::string, FunctionVersion> FunctionVersions;
+    // recompiles run on the threads calling evicted functions
+    std::mutex FunctionsMutex;
+
+    uint64_t MemoryBudget;
+    TargetLibraryInfoImpl::VectorLibrary VectorLibrary;
+    // advanced by EnforceMemoryBudget, orders the calls of functions
+    std::atomic<uint64_t> Epoch{1};
+    std::atomic<uint64_t> Evictions{0};
+    std::atomic<uint64_t> Recompiles{0};
 
 public:
-    JIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB, const DataLayout &DL)
-            : ES(std::move(ES)), DL(DL), Mangle(*this->ES, this->DL),
-              ObjectLayer(
-                      *this->ES,
-                      []() { return std::make_unique<SectionMemoryManager>(); }
-              ),
+    JIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB, const DataLayout &DL,
+        const JITOptions &Options)
+            : ES(std::move(ES)), JTMB(std::move(JTMB)), DL(DL), Mangle(*this->ES, this->DL),
+              Cache(CreateObjectCache(this->JTMB, Options)),
+              Profiler(Options.PerfMap || Options.JitDump
+                       ? std::make_unique<PerfProfiler>(Options.PerfMap, Options.JitDump)
+                       : nullptr),
+              ObjectLayer(CreateObjectLayer(*this->ES, this->JTMB, Options, CodeMemory, SectionMemory,
+                                            Profiler.get())),
               CompileLayer(
                       *this->ES,
-                      ObjectLayer,
-                      std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))
+                      *ObjectLayer,
+                      std::make_unique<TimedIRCompiler>(
+                              std::make_unique<ConcurrentIRCompiler>(this->JTMB, Cache.get()))
               ),
               OptimizeLayer(
                       *this->ES,
                       CompileLayer,
                       OptimizeModule
               ),
-              Main(this->ES->createBareJITDylib("<main>")) {
+              Tier1Layer(
+                      *this->ES,
+                      CompileLayer,
+                      [this](ThreadSafeModule TSM, const MaterializationResponsibility &MR) {
+                          return OptimizeModuleAggressively(std::move(TSM), MR);
+                      }
+              ),
+              Main(this->ES->createBareJITDylib("<main>")),
+              BuiltIns(this->ES->createBareJITDylib("<builtins>")),
+              Stubs(createLocalIndirectStubsManagerBuilder(this->JTMB.getTargetTriple())()),
+              MemoryBudget(Options.MemoryBudget),
+              VectorLibrary(Options.VectorLibrary) {
         Main.addGenerator(cantFail(
                 DynamicLibrarySearchGenerator::GetForCurrentProcess(DL.getGlobalPrefix())
         ));
-        if (JTMB.getTargetTriple().isOSBinFormatCOFF()) {
-            ObjectLayer.setOverrideObjectFlagsWithResponsibilityFlags(true);
-            ObjectLayer.setAutoClaimResponsibilityForObjectSymbols(true);
+
+        // searched after Main, so functions of the same name replace them
+        SymbolMap BuiltInSymbols;
+        for (auto &BuiltIn: GetBuiltIns()) {
+            BuiltInSymbols[Mangle(BuiltIn.first)] =
+                    JITEvaluatedSymbol(pointerToJITTargetAddress(BuiltIn.second), JITSymbolFlags::Exported);
+        }
+        cantFail(BuiltIns.define(absoluteSymbols(std::move(BuiltInSymbols))));
+        Main.addToLinkOrder(BuiltIns);
+
+        if (MemoryBudget) {
+            cantFail(Main.define(absoluteSymbols({
+                {Mangle("__solid_epoch"),
+                    JITEvaluatedSymbol(pointerToJITTargetAddress(&Epoch), JITSymbolFlags::Exported)},
+                {Mangle("__solid_recompile"),
+                    JITEvaluatedSymbol(pointerToJITTargetAddress(&RecompileHook), JITSymbolFlags::Exported)},
+                {Mangle("__solid_recompile_context"),
+                    JITEvaluatedSymbol(pointerToJITTargetAddress(this), JITSymbolFlags::Exported)}
+            })));
+        }
+
+        if (Options.Tiered) {
+            Tiers = std::make_unique<TieredCompiler>(*this->ES, Tier1Layer, Main, Mangle, Options.TierUpThreshold);
+            cantFail(Tiers->Start());
+
+            OptimizeLayer.setTransform(
+                    [this](ThreadSafeModule TSM, const MaterializationResponsibility &MR) -> Expected<ThreadSafeModule> {
+                        if (TieredCompiler::IsTierable(TSM))
+                            return Tiers->Instrument(std::move(TSM));
+                        return OptimizeModule(std::move(TSM), MR);
+                    }
+            );
         }
     }
 
     ~JIT() {
+        // stop background compilation before the session goes away
+        Tiers.reset();
+
         if (auto Err = ES->endSession())
             ES->reportError(std::move(Err));
     }
 
-    static Expected<std::unique_ptr<JIT>> Create() {
-        auto EPC = SelfExecutorProcessControl::Create();
+    static Expected<std::unique_ptr<JIT>> Create(const JITOptions &Options = JITOptions()) {
+        if (auto Err = LoadVectorLibrary(Options.VectorLibrary))
+            return std::move(Err);
+
+        std::unique_ptr<TaskDispatcher> Dispatcher;
+        if (Options.CompileThreads != 1)
+            Dispatcher = std::make_unique<ThreadPoolDispatcher>(Options.CompileThreads);
+
+        auto EPC = SelfExecutorProcessControl::Create(nullptr, std::move(Dispatcher));
         if (!EPC)
             return EPC.takeError();
 
@@ -84,7 +262,7 @@ public:
         if (!DL)
             return DL.takeError();
 
-        return std::make_unique<JIT>(std::move(ES), std::move(JTMB), std::move(*DL));
+        return std::make_unique<JIT>(std::move(ES), std::move(JTMB), std::move(*DL), Options);
     }
 
     const DataLayout &GetDataLayout() const { return DL; }
@@ -97,13 +275,354 @@ public:
         return OptimizeLayer.add(RT, std::move(TSM));
     }
 
+    // Adds a module that is optimized at O3 (and never tiered), for code that is worth a longer compile
+    Error AddOptimizedModule(ThreadSafeModule TSM, ResourceTrackerSP RT = nullptr) {
+        if (!RT)
+            RT = Main.getDefaultResourceTracker();
+        return Tier1Layer.add(RT, std::move(TSM));
+    }
+
+    // Adds all modules and compiles them right away, in parallel when there are compile threads
+    Error AddModules(std::vector<ThreadSafeModule> Modules) {
+        SymbolLookupSet Symbols;
+        for (auto &TSM: Modules) {
+            TSM.withModuleDo([&](Module &Mod) {
+                for (auto &Value: Mod.global_values()) {
+                    if (!Value.isDeclaration() && !Value.hasLocalLinkage())
+                        Symbols.add(Mangle(Value.getName()));
+                }
+            });
+
+            if (auto Err = AddModule(std::move(TSM)))
+                return Err;
+        }
+
+        // a single lookup hands all modules to the dispatcher at once
+        return ES->lookup(makeJITDylibSearchOrder(&Main), std::move(Symbols)).takeError();
+    }
+
+    // Adds modules that define one function each. A function that is defined already is replaced:
+    // its stub is switched to the new version, then the old version's code is removed.
+    Error AddFunctions(std::vector<ThreadSafeModule> Modules) {
+        std::lock_guard<std::mutex> Lock(FunctionsMutex);
+
+        std::vector<PendingVersion> Added;
+        SymbolLookupSet Symbols;
+
+        for (auto &TSM: Modules) {
+            std::string Name;
+            unsigned Arity = 0;
+            auto Err = TSM.withModuleDo([&](Module &Mod) -> Error {
+                Function *Defined = nullptr;
+                for (auto &Func: Mod) {
+                    // like the bodies of parallel loops
+                    if (Func.isDeclaration() || Func.hasLocalLinkage())
+                        continue;
+                    if (Defined)
+                        return make_error<StringError>("Module defines more than one function",
+                                                       inconvertibleErrorCode());
+                    Defined = &Func;
+                }
+                if (!Defined)
+                    return make_error<StringError>("Module defines no function", inconvertibleErrorCode());
+
+                Name = Defined->getName().str();
+                Arity = Defined->arg_size();
+                return Error::success();
+            });
+            if (Err)
+                return Err;
+
+            auto &Current = FunctionVersions[Name];
+            unsigned Version = ++Current.Version;
+
+            PendingVersion Next;
+            Next.Name = Name;
+            Next.Implementation = Name + "$v" + std::to_string(Version);
+            Next.Tracker = Main.createResourceTracker();
+
+            TSM.withModuleDo([&](Module &Mod) {
+                Function *Func = Mod.getFunction(Name);
+                Func->setName(Next.Implementation);
+
+                if (MemoryBudget) {
+                    AddCallStamp(Mod, *Func, Name);
+                    raw_svector_ostream Stream(Next.Bitcode);
+                    WriteBitcodeToFile(Mod, Stream);
+                }
+            });
+
+            // other modules link against the stub, create it before anything is compiled
+            if (Version == 1) {
+                if (auto Err = Stubs->createStub(Name, 0, JITSymbolFlags::Exported))
+                    return Err;
+
+                SymbolMap Definitions;
+                Definitions[Mangle(Name)] = Stubs->findStub(Name, true);
+                if (MemoryBudget) {
+                    Definitions[Mangle(Name + "$called")] =
+                            JITEvaluatedSymbol(pointerToJITTargetAddress(&Current.LastCalled), JITSymbolFlags::Exported);
+                }
+                if (auto Err = Main.define(absoluteSymbols(std::move(Definitions))))
+                    return Err;
+            }
+
+            // the thunk is only compiled when the version is evicted, and isn't optimized or tiered
+            if (MemoryBudget) {
+                Next.ThunkTracker = Main.createResourceTracker();
+                if (auto Err = CompileLayer.add(Next.ThunkTracker, CreateRecompileThunk(Name, Next.Implementation, Arity)))
+                    return Err;
+            }
+
+            Symbols.add(Mangle(Next.Implementation));
+            if (auto Err = AddModule(std::move(TSM), Next.Tracker))
+                return Err;
+            Added.push_back(std::move(Next));
+        }
+
+        auto Addresses = ES->lookup(makeJITDylibSearchOrder(&Main), std::move(Symbols));
+        if (!Addresses)
+            return Addresses.takeError();
+
+        for (auto &Next: Added) {
+            auto &Current = FunctionVersions[Next.Name];
+
+            if (auto Err = Stubs->updatePointer(Next.Name, (*Addresses)[Mangle(Next.Implementation)].getAddress()))
+                return Err;
+
+            // nothing calls the old version anymore
+            if (Current.Tracker) {
+                if (Tiers) {
+                    if (auto Err = Tiers->Remove(Current.Implementation))
+                        return Err;
+                }
+                if (auto Err = Current.Tracker->remove())
+                    return Err;
+            }
+            if (Current.ThunkTracker) {
+                if (auto Err = Current.ThunkTracker->remove())
+                    return Err;
+            }
+
+            Current.Implementation = std::move(Next.Implementation);
+            Current.Tracker = std::move(Next.Tracker);
+            Current.ThunkTracker = std::move(Next.ThunkTracker);
+            Current.Bitcode = std::move(Next.Bitcode);
+            // new definitions are as recent as the last call
+            Current.LastCalled = Epoch.load();
+        }
+
+        return Error::success();
+    }
+
+    // Evicts the code of the least recently called functions while JIT'd code and data take more than the budget.
+    // Must only be called while no JIT'd code runs, e.g. between top level expressions.
+    Error EnforceMemoryBudget() {
+        if (!MemoryBudget)
+            return Error::success();
+
+        std::lock_guard<std::mutex> Lock(FunctionsMutex);
+
+        // calls from now on are more recent than all calls before
+        Epoch++;
+
+        if (GetUsedCodeMemory() <= MemoryBudget)
+            return Error::success();
+
+        std::vector<std::pair<uint64_t, std::string>> Candidates;
+        for (auto &Entry: FunctionVersions) {
+            if (Entry.second.Tracker)
+                Candidates.emplace_back(Entry.second.LastCalled.load(), Entry.first);
+        }
+        std::sort(Candidates.begin(), Candidates.end());
+
+        for (auto &Candidate: Candidates) {
+            if (GetUsedCodeMemory() <= MemoryBudget)
+                break;
+            if (auto Err = Evict(Candidate.second))
+                return Err;
+        }
+
+        return Error::success();
+    }
+
+    MemoryBudgetStats GetMemoryBudgetStats() const {
+        MemoryBudgetStats Stats;
+        Stats.Evictions = Evictions.load();
+        Stats.Recompiles = Recompiles.load();
+        return Stats;
+    }
+
     Expected<JITEvaluatedSymbol> Lookup(StringRef Name) {
-        return ES->lookup({&Main}, Mangle(Name.str()));
+        return ES->lookup(makeJITDylibSearchOrder({&Main, &BuiltIns}), Mangle(Name.str()));
+    }
+
+    // Memory used by JIT'd code and data (mappings are only tracked when JITLink is used)
+    CodeMemoryStats GetCodeMemoryStats() {
+        if (!CodeMemory)
+            return SectionMemory.GetStats();
+        return CodeMemory->GetStats();
     }
 
 private:
+    uint64_t GetUsedCodeMemory() {
+        auto Stats = GetCodeMemoryStats();
+        return Stats.CodeBytes + Stats.DataBytes;
+    }
+
+    Error Evict(const std::string &Name) {
+        auto &Current = FunctionVersions[Name];
+
+        auto Thunk = ES->lookup({&Main}, Mangle(Current.Implementation + "$recompile"));
+        if (!Thunk)
+            return Thunk.takeError();
+        if (auto Err = Stubs->updatePointer(Name, Thunk->getAddress()))
+            return Err;
+
+        if (Tiers) {
+            if (auto Err = Tiers->Remove(Current.Implementation))
+                return Err;
+        }
+        if (auto Err = Current.Tracker->remove())
+            return Err;
+
+        Current.Tracker = nullptr;
+        Evictions++;
+        return Error::success();
+    }
+
+    // Adds an evicted function again and returns the address of its code
+    Expected<JITTargetAddress> Recompile(const std::string &Name) {
+        std::lock_guard<std::mutex> Lock(FunctionsMutex);
+
+        auto &Current = FunctionVersions[Name];
+        Current.LastCalled = Epoch.load();
+
+        // another thread called it first
+        if (Current.Tracker) {
+            auto Symbol = ES->lookup({&Main}, Mangle(Current.Implementation));
+            if (!Symbol)
+                return Symbol.takeError();
+            return Symbol->getAddress();
+        }
+
+        auto Context = std::make_unique<LLVMContext>();
+        auto Mod = parseBitcodeFile(MemoryBufferRef(StringRef(Current.Bitcode.data(), Current.Bitcode.size()),
+                                                    Current.Implementation), *Context);
+        if (!Mod)
+            return Mod.takeError();
+
+        auto Tracker = Main.createResourceTracker();
+        if (auto Err = AddModule(ThreadSafeModule(std::move(*Mod), std::move(Context)), Tracker))
+            return std::move(Err);
+
+        auto Symbol = ES->lookup({&Main}, Mangle(Current.Implementation));
+        if (!Symbol) {
+            cantFail(Tracker->remove());
+            return Symbol.takeError();
+        }
+        if (auto Err = Stubs->updatePointer(Name, Symbol->getAddress()))
+            return std::move(Err);
+
+        Current.Tracker = std::move(Tracker);
+        Recompiles++;
+        return Symbol->getAddress();
+    }
+
+    // Called by recompile thunks (from JIT'd code)
+    static void *RecompileHook(JIT *Self, const char *Name) {
+        auto Address = Self->Recompile(Name);
+        if (!Address)
+            report_fatal_error(Address.takeError());
+        return jitTargetAddressToPointer<void *>(*Address);
+    }
+
+    // Stores the current epoch in `<Name>$called` when the function is entered
+    static void AddCallStamp(Module &Mod, Function &Func, const std::string &Name) {
+        auto &Context = Mod.getContext();
+        Constant *CurrentEpoch = Mod.getOrInsertGlobal("__solid_epoch", Type::getInt64Ty(Context));
+        Constant *LastCalled = Mod.getOrInsertGlobal(Name + "$called", Type::getInt64Ty(Context));
+
+        IRBuilder<> Builder(&*Func.getEntryBlock().getFirstInsertionPt());
+        LoadInst *Load = Builder.CreateAlignedLoad(Type::getInt64Ty(Context), CurrentEpoch, Align(8), "epoch");
+        Load->setAtomic(AtomicOrdering::Monotonic);
+        StoreInst *Store = Builder.CreateAlignedStore(Load, LastCalled, Align(8));
+        Store->setAtomic(AtomicOrdering::Monotonic);
+    }
+
+    // `<Implementation>$recompile` takes the place of an evicted version: it recompiles it and forwards the call
+    ThreadSafeModule CreateRecompileThunk(const std::string &Name, const std::string &Implementation, unsigned Arity) {
+        auto Context = std::make_unique<LLVMContext>();
+        auto Mod = std::make_unique<Module>(Implementation + "$recompile", *Context);
+        Mod->setDataLayout(DL);
+
+        auto *Double = Type::getDoubleTy(*Context);
+        auto *Int8Ptr = Type::getInt8PtrTy(*Context);
+        auto *ThunkType = FunctionType::get(Double, std::vector<Type *>(Arity, Double), false);
+        auto *Thunk = Function::Create(ThunkType, Function::ExternalLinkage, Implementation + "$recompile", *Mod);
+
+        FunctionCallee Hook = Mod->getOrInsertFunction("__solid_recompile",
+                                                       FunctionType::get(Int8Ptr, {Int8Ptr, Int8Ptr}, false));
+        Constant *HookContext = Mod->getOrInsertGlobal("__solid_recompile_context", Type::getInt8Ty(*Context));
+
+        IRBuilder<> Builder(BasicBlock::Create(*Context, "entry", Thunk));
+        Value *Target = Builder.CreateCall(Hook, {HookContext, Builder.CreateGlobalStringPtr(Name, Name + "$name")},
+                                           "target");
+        Target = Builder.CreateBitCast(Target, ThunkType->getPointerTo());
+
+        std::vector<Value *> Arguments;
+        for (auto &Argument: Thunk->args())
+            Arguments.push_back(&Argument);
+
+        CallInst *Result = Builder.CreateCall(ThunkType, Target, Arguments, "calltmp");
+        Result->setTailCallKind(CallInst::TCK_Tail);
+        Builder.CreateRet(Result);
+
+        return ThreadSafeModule(std::move(Mod), std::move(Context));
+    }
+
+    static std::unique_ptr<class ObjectLayer> CreateObjectLayer(ExecutionSession &ES, JITTargetMachineBuilder &JTMB,
+                                                                const JITOptions &Options,
+                                                                SlabMemoryManager *&CodeMemory,
+                                                                CountingMemoryManager::Counter &SectionMemory,
+                                                                PerfProfiler *Profiler) {
+        if (Options.UseJITLink) {
+            auto MemoryManager = cantFail(SlabMemoryManager::Create(Options.SlabSize));
+            CodeMemory = MemoryManager.get();
+            auto Layer = std::make_unique<ObjectLinkingLayer>(ES, std::move(MemoryManager));
+            if (Profiler)
+                Layer->addPlugin(Profiler->CreatePlugin());
+            return Layer;
+        }
+
+        auto Layer = std::make_unique<RTDyldObjectLinkingLayer>(
+                ES,
+                [&SectionMemory]() { return std::make_unique<CountingMemoryManager>(SectionMemory); }
+        );
+        if (JTMB.getTargetTriple().isOSBinFormatCOFF()) {
+            Layer->setOverrideObjectFlagsWithResponsibilityFlags(true);
+            Layer->setAutoClaimResponsibilityForObjectSymbols(true);
+        }
+        if (Profiler)
+            Layer->registerJITEventListener(*Profiler);
+        return Layer;
+    }
+
+    static std::unique_ptr<JITObjectCache> CreateObjectCache(JITTargetMachineBuilder &JTMB, const JITOptions &Options) {
+        if (Options.CacheDirectory.empty())
+            return nullptr;
+
+        // everything besides the IR that influences the generated code
+        std::string Configuration = JTMB.getTargetTriple().str() + ";" + JTMB.getCPU() + ";" +
+                                    JTMB.getFeatures().getString() + ";" + (Options.Tiered ? "tiered" : "default") + ";veclib" +
+                                    std::to_string(Options.VectorLibrary) + "\n";
+
+        return std::make_unique<JITObjectCache>(Options.CacheDirectory, Options.CacheSizeLimit, Configuration);
+    }
+
     static Expected<ThreadSafeModule> OptimizeModule(ThreadSafeModule TSM, const MaterializationResponsibility &MR) {
         TSM.withModuleDo([](Module &Mod) {
+            PhaseTimer Timer(Phase::JITPasses);
             auto PassManager = std::make_unique<legacy::FunctionPassManager>(&Mod);
 
             PassManager->add(createPromoteMemoryToRegisterPass());
@@ -119,6 +638,23 @@ private:
 
         return std::move(TSM);
     }
+
+    Expected<ThreadSafeModule> OptimizeModuleAggressively(ThreadSafeModule TSM, const MaterializationResponsibility &MR) {
+        auto Machine = JTMB.createTargetMachine();
+        if (!Machine)
+            return Machine.takeError();
+
+        // the runtime is only linked where the inliner runs
+        if (auto Err = TSM.withModuleDo([&](Module &Mod) -> Error {
+                if (auto Err = LinkRuntime(Mod))
+                    return Err;
+                RunOptimizationPipeline(Mod, OptimizationLevel::O3, Machine->get(), VectorLibrary);
+                return Error::success();
+            }))
+            return std::move(Err);
+
+        return std::move(TSM);
+    }
 };
 
 #endif
@@ -1,19 +1,34 @@
+#include "CompileStats.h"
 #include "Lexer.h"
 
 bool IsDigitCharacter(char Input) {
     return isdigit(Input) || Input == '.';
 }
 
+int Lexer::ReadChar() {
+    if (In)
+        return getc(In);
+    if (Position < Source.size())
+        return (unsigned char) Source[Position++];
+    return EOF;
+}
+
+int Lexer::GetNextToken() {
+    PhaseTimer Timer(Phase::Lexing);
+    CurrentToken = GetToken();
+    return CurrentToken;
+}
+
 int Lexer::GetToken() {
     while (isspace(LastChar))
-        LastChar = getc(In);
+        LastChar = ReadChar();
 
     if (isalpha(LastChar)) {
         IdVal = (char) LastChar;
-        LastChar = getc(In);
+        LastChar = ReadChar();
         while (isalnum(LastChar)) {
             IdVal += (char) LastChar;
-            LastChar = getc(In);
+            LastChar = ReadChar();
         }
 
         if (IdVal == "func")
@@ -28,6 +43,12 @@ int Lexer::GetToken() {
             return t_otherwise;
         else if (IdVal == "while")
             return t_while;
+        else if (IdVal == "parallel")
+            return t_parallel;
+        else if (IdVal == "spawn")
+            return t_spawn;
+        else if (IdVal == "sync")
+            return t_sync;
         else if (IdVal == "let")
             return t_let;
         else if (IdVal == "in")
@@ -49,16 +70,27 @@ int Lexer::GetToken() {
         std::string Num;
         do {
             Num += (char) LastChar;
-            LastChar = getc(In);
+            LastChar = ReadChar();
         } while (IsDigitCharacter(LastChar));
 
         NumVal = strtod(Num.c_str(), nullptr);
         return t_num;
     }
 
+    // REPL commands like `\memory`
+    if (LastChar == '\\') {
+        IdVal.clear();
+        LastChar = ReadChar();
+        while (isalnum(LastChar)) {
+            IdVal += (char) LastChar;
+            LastChar = ReadChar();
+        }
+        return t_command;
+    }
+
     if (LastChar == '#') {
         do {
-            LastChar = getc(In);
+            LastChar = ReadChar();
         } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
 
         if (LastChar != EOF)
@@ -69,6 +101,6 @@ int Lexer::GetToken() {
         return t_eof;
 
     int Current = LastChar;
-    LastChar = getc(In);
+    LastChar = ReadChar();
     return Current;
 }
@@ -1,6 +1,7 @@
 #ifndef SOLID_LANG_LEXER_H
 #define SOLID_LANG_LEXER_H
 
+#include <cstdio>
 #include <string>
 
 enum Token {
@@ -20,6 +21,10 @@ enum Token {
     t_unary = -14,
     t_binary = -15,
     t_operator = -16,
+    t_command = -17,
+    t_parallel = -18,
+    t_spawn = -19,
+    t_sync = -20,
 };
 
 class Lexer {
@@ -27,25 +32,42 @@ class Lexer {
 public:
     explicit Lexer(FILE *In) : In(In) {}
 
-    int GetCurrentToken() const { return CurrentToken; }
+    // reads from a string instead of a file
+    explicit Lexer(std::string Source) : Source(std::move(Source)) {}
+
+    // continues with another string, e.g. the next source compiled in a session
+    void SetSource(std::string NextSource) {
+        Source = std::move(NextSource);
+        Position = 0;
+        LastChar = ' ';
+    }
 
-    int GetNextToken() {
-        CurrentToken = GetToken();
-        return CurrentToken;
+    // continues with another file, e.g. the input after the prelude
+    void SetInput(FILE *NextIn) {
+        In = NextIn;
+        LastChar = ' ';
     }
 
+    int GetCurrentToken() const { return CurrentToken; }
+
+    int GetNextToken();
+
     std::string GetIdVal() { return IdVal; }
 
     double GetNumVal() const { return NumVal; }
 
 private:
-    FILE *In;
+    FILE *In = nullptr;
+    std::string Source;
+    size_t Position = 0;
     std::string IdVal;
     double NumVal;
     int LastChar = ' ';
     int CurrentToken;
 
     int GetToken();
+
+    int ReadChar();
 };
 
 
@@ -0,0 +1,79 @@
+#include "llvm/Support/DynamicLibrary.h"
+#include <cmath>
+#include "MathBuiltIns.h"
+
+namespace {
+
+template<typename FunctionType>
+void *GetAddress(FunctionType *Function) {
+    return (void *) Function;
+}
+
+using Unary = double(double);
+using Binary = double(double, double);
+
+const MathBuiltIn MathBuiltIns[] = {
+        {"sqrt",  1, Intrinsic::sqrt,   GetAddress<Unary>(::sqrt)},
+        {"exp",   1, Intrinsic::exp,    GetAddress<Unary>(::exp)},
+        {"exp2",  1, Intrinsic::exp2,   GetAddress<Unary>(::exp2)},
+        {"log",   1, Intrinsic::log,    GetAddress<Unary>(::log)},
+        {"log2",  1, Intrinsic::log2,   GetAddress<Unary>(::log2)},
+        {"log10", 1, Intrinsic::log10,  GetAddress<Unary>(::log10)},
+        {"sin",   1, Intrinsic::sin,    GetAddress<Unary>(::sin)},
+        {"cos",   1, Intrinsic::cos,    GetAddress<Unary>(::cos)},
+        {"fabs",  1, Intrinsic::fabs,   GetAddress<Unary>(::fabs)},
+        {"floor", 1, Intrinsic::floor,  GetAddress<Unary>(::floor)},
+        {"ceil",  1, Intrinsic::ceil,   GetAddress<Unary>(::ceil)},
+        {"trunc", 1, Intrinsic::trunc,  GetAddress<Unary>(::trunc)},
+        {"round", 1, Intrinsic::round,  GetAddress<Unary>(::round)},
+        {"pow",   2, Intrinsic::pow,    GetAddress<Binary>(::pow)},
+        {"fmin",  2, Intrinsic::minnum, GetAddress<Binary>(::fmin)},
+        {"fmax",  2, Intrinsic::maxnum, GetAddress<Binary>(::fmax)},
+};
+
+}
+
+const MathBuiltIn *GetMathBuiltIn(StringRef Name) {
+    for (auto &BuiltIn: MathBuiltIns) {
+        if (Name == BuiltIn.Name)
+            return &BuiltIn;
+    }
+    return nullptr;
+}
+
+Error LoadVectorLibrary(TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    const char *Path;
+    switch (VectorLibrary) {
+        case TargetLibraryInfoImpl::Accelerate:
+            Path = "/System/Library/Frameworks/Accelerate.framework/Accelerate";
+            break;
+        case TargetLibraryInfoImpl::LIBMVEC_X86:
+            Path = "libmvec.so.1";
+            break;
+        case TargetLibraryInfoImpl::SVML:
+            Path = "libsvml.so";
+            break;
+        default:
+            // nothing or part of the C library
+            return Error::success();
+    }
+
+    std::string Message;
+    if (sys::DynamicLibrary::LoadLibraryPermanently(Path, &Message))
+        return make_error<StringError>("could not load vector library " + std::string(Path) + ": " + Message,
+                                       inconvertibleErrorCode());
+    return Error::success();
+}
+
+const char *GetVectorLibraryLinkOption(TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    switch (VectorLibrary) {
+        case TargetLibraryInfoImpl::Accelerate:
+            return "-Wl,-framework,Accelerate";
+        case TargetLibraryInfoImpl::LIBMVEC_X86:
+            return "-lmvec";
+        case TargetLibraryInfoImpl::SVML:
+            return "-lsvml";
+        default:
+            return nullptr;
+    }
+}
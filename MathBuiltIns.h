@@ -0,0 +1,31 @@
+#ifndef SOLID_LANG_MATHBUILTINS_H
+#define SOLID_LANG_MATHBUILTINS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/Error.h"
+
+using namespace llvm;
+
+// Math functions that can be called without a `native` declaration (`sqrt`, `pow`, `fmin`, ...).
+// The IR generator emits them as LLVM intrinsics, which LLVM can constant fold, inline and vectorize.
+// The VM and the interpreter call the C library functions of the same name.
+struct MathBuiltIn {
+    const char *Name;
+    unsigned Arity;
+    Intrinsic::ID Intrinsic;
+    void *Address;
+};
+
+// The math built-in called Name, nothing if there is none
+const MathBuiltIn *GetMathBuiltIn(StringRef Name);
+
+// Loads the vector math library the vectorizer calls into when it's set up with VectorLibrary (--veclib),
+// so the JIT can resolve its functions.
+Error LoadVectorLibrary(TargetLibraryInfoImpl::VectorLibrary VectorLibrary);
+
+// The linker option of VectorLibrary, null if it's part of the C library (or there is none)
+const char *GetVectorLibraryLinkOption(TargetLibraryInfoImpl::VectorLibrary VectorLibrary);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SOLID_LANG_NATIVECALL_H
+#define SOLID_LANG_NATIVECALL_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include <cstdint>
+
+using namespace llvm;
+
+// functions with more arguments can't be called from outside of compiled code
+const unsigned MaxNativeArguments = 6;
+
+// Calls a compiled function `double (double, ...)` at Address
+inline double CallNative(uint64_t Address, ArrayRef<double> Arguments) {
+    switch (Arguments.size()) {
+        case 0:
+            return ((double (*)()) Address)();
+        case 1:
+            return ((double (*)(double)) Address)(Arguments[0]);
+        case 2:
+            return ((double (*)(double, double)) Address)(Arguments[0], Arguments[1]);
+        case 3:
+            return ((double (*)(double, double, double)) Address)(Arguments[0], Arguments[1], Arguments[2]);
+        case 4:
+            return ((double (*)(double, double, double, double)) Address)(
+                    Arguments[0], Arguments[1], Arguments[2], Arguments[3]);
+        case 5:
+            return ((double (*)(double, double, double, double, double)) Address)(
+                    Arguments[0], Arguments[1], Arguments[2], Arguments[3], Arguments[4]);
+        case 6:
+            return ((double (*)(double, double, double, double, double, double)) Address)(
+                    Arguments[0], Arguments[1], Arguments[2], Arguments[3], Arguments[4], Arguments[5]);
+        default:
+            return 0;
+    }
+}
+
+#endif
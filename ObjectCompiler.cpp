@@ -0,0 +1,305 @@
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Object/ArchiveWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "CompileStats.h"
+#include "MathBuiltIns.h"
+#include "ObjectCompiler.h"
+#include "Optimizer.h"
+#include "RuntimeBitcode.h"
+
+namespace {
+
+// Function and the functions it uses that other objects may not define, like internal ones and prelude functions
+SetVector<const Function *> GetPartition(const Function &Function) {
+    SetVector<const class Function *> Partition;
+    Partition.insert(&Function);
+
+    for (size_t i = 0; i < Partition.size(); ++i) {
+        for (auto &Instruction: instructions(*Partition[i])) {
+            for (auto &Operand: Instruction.operands()) {
+                auto *Used = dyn_cast<class Function>(Operand->stripPointerCasts());
+                if (Used && Used->isDiscardableIfUnused() && !Used->isDeclaration())
+                    Partition.insert(Used);
+            }
+        }
+    }
+
+    return Partition;
+}
+
+CodeGenOpt::Level GetCodeGenLevel(OptimizationLevel Level) {
+    switch (Level.getSpeedupLevel()) {
+        case 0:
+            return CodeGenOpt::None;
+        case 1:
+            return CodeGenOpt::Less;
+        case 3:
+            return CodeGenOpt::Aggressive;
+        default:
+            return CodeGenOpt::Default;
+    }
+}
+
+// The optimization level, the vector library, the target, the compiler and the runtime that could be inlined, objects
+// of other configurations aren't reused
+std::string GetConfiguration(TargetMachine &Machine, OptimizationLevel Level,
+                             TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    return "O" + std::to_string(Level.getSpeedupLevel()) + ";veclib" + std::to_string(VectorLibrary) + ";" + Machine.getTargetTriple().str() + ";" + Machine.getTargetCPU().str() + ";" +
+           Machine.getTargetFeatureString().str() + ";reloc " + std::to_string(Machine.getRelocationModel()) + ";LLVM " LLVM_VERSION_STRING ";runtime " +
+           (HasRuntimeBitcode() ? CompileCache::Hash(GetRuntimeBitcode()) : "none") + "\n";
+}
+
+Error WriteFile(StringRef Path, StringRef Content) {
+    std::error_code ErrorCode;
+    raw_fd_ostream Out(Path, ErrorCode, sys::fs::OF_None);
+    if (ErrorCode)
+        return errorCodeToError(ErrorCode);
+
+    Out << Content;
+    Out.close();
+    if (Out.has_error())
+        return errorCodeToError(Out.error());
+    return Error::success();
+}
+
+Error LinkSharedLibrary(const std::vector<std::string> &Objects, const std::vector<ExportedFunction> &Functions,
+                        StringRef OutputFile, StringRef RuntimeDirectory,
+                        TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    auto Linker = sys::findProgramByName("c++");
+    if (!Linker)
+        return make_error<StringError>("c++ not found, it links " + OutputFile, inconvertibleErrorCode());
+
+    // everything else stays local, like the prelude's operators
+    bool Darwin = Triple(sys::getProcessTriple()).isOSDarwin();
+    std::string Exports;
+    for (auto &Function: Functions)
+        Exports += Darwin ? "_" + Function.Name + "\n" : "    " + Function.Name + ";\n";
+    if (!Darwin)
+        Exports = "{\n" + (Exports.empty() ? "" : "  global:\n" + Exports) + "  local: *;\n};\n";
+
+    SmallString<128> ExportsFile;
+    if (auto ErrorCode = sys::fs::createTemporaryFile("solid", "exports", ExportsFile))
+        return errorCodeToError(ErrorCode);
+    if (auto Err = WriteFile(ExportsFile, Exports)) {
+        sys::fs::remove(ExportsFile);
+        return Err;
+    }
+
+    std::string ExportsOption =
+            (Darwin ? "-Wl,-exported_symbols_list," : "-Wl,--version-script=") + ExportsFile.str().str();
+    std::vector<StringRef> Arguments = {*Linker, "-shared", "-o", OutputFile};
+    for (auto &Object: Objects)
+        Arguments.push_back(Object);
+    // linked with the runtime of the build tree (or the given one), loaded from next to the library by default
+    std::string LinkDirectory = "-L" + RuntimeDirectory.str();
+    std::string RunPath = "-Wl,-rpath," + (RuntimeDirectory.empty() ? (Darwin ? "@loader_path" : "$ORIGIN")
+                                                                    : RuntimeDirectory.str());
+    if (!RuntimeDirectory.empty())
+        Arguments.push_back(LinkDirectory);
+    Arguments.insert(Arguments.end(), {"-L" SOLID_RUNTIME_DIRECTORY, RunPath, "-lsolid_runtime", "-lm", ExportsOption});
+    if (const char *VectorLibraryOption = GetVectorLibraryLinkOption(VectorLibrary))
+        Arguments.push_back(VectorLibraryOption);
+
+    std::string Message;
+    int Result = sys::ExecuteAndWait(*Linker, Arguments, {}, {}, 0, 0, &Message);
+    sys::fs::remove(ExportsFile);
+    if (Result != 0)
+        return make_error<StringError>("linking " + OutputFile + " failed " + Message, inconvertibleErrorCode());
+    return Error::success();
+}
+
+Error WriteArchive(const std::vector<std::string> &Objects, const std::vector<std::string> &Names,
+                   StringRef OutputFile) {
+    std::vector<NewArchiveMember> Members;
+    for (size_t i = 0; i < Objects.size(); ++i) {
+        auto Member = NewArchiveMember::getFile(Objects[i], true);
+        if (!Member)
+            return Member.takeError();
+        Member->MemberName = Names[i];
+        Members.push_back(std::move(*Member));
+    }
+
+    auto Kind = Triple(sys::getProcessTriple()).isOSDarwin() ? object::Archive::K_DARWIN : object::Archive::K_GNU;
+    return writeArchive(OutputFile, Members, true, Kind, true, false);
+}
+
+}
+
+Error CompileObject(Module &Module, TargetMachine &Machine, raw_pwrite_stream &Object, OptimizationLevel Level,
+                    TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    // inline the built-ins, which the program is linked with as well
+    if (auto Err = LinkRuntime(Module))
+        return Err;
+    if (Level.getSpeedupLevel() >= 2)
+        RunOptimizationPipeline(Module, Level, &Machine, VectorLibrary);
+
+    Machine.setOptLevel(GetCodeGenLevel(Level));
+
+    PhaseTimer Timer(Phase::ObjectEmission);
+    CountInstructions(Module);
+    legacy::PassManager OutputPassManager;
+    if (Machine.addPassesToEmitFile(OutputPassManager, Object, nullptr, CGFT_ObjectFile))
+        return make_error<StringError>("could not emit file", inconvertibleErrorCode());
+
+    OutputPassManager.run(Module);
+    return Error::success();
+}
+
+Error CompileObjectIncrementally(Module &Module, TargetMachine &Machine, CompileCache &Cache, StringRef OutputFile,
+                                 IncrementalStats &Stats, OptimizationLevel Level,
+                                 TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    std::string Configuration = GetConfiguration(Machine, Level, VectorLibrary);
+
+    std::vector<std::string> Objects;
+    auto RemoveObjects = [&]() {
+        for (auto &Object: Objects)
+            sys::fs::remove(Object);
+    };
+
+    for (auto &Function: Module) {
+        // internal and prelude functions are compiled with the functions using them
+        if (Function.isDeclaration() || Function.isDiscardableIfUnused())
+            continue;
+
+        auto Partition = GetPartition(Function);
+        ValueToValueMapTy Values;
+        auto PartitionModule = CloneModule(Module, Values, [&](const GlobalValue *Value) {
+            auto *Defined = dyn_cast<class Function>(Value);
+            return Defined && Partition.count(Defined);
+        });
+
+        // the key only depends on the partition: not on the other functions of the file (which CloneModule declares)
+        // nor on the file's name
+        for (auto &Declared: make_early_inc_range(*PartitionModule)) {
+            if (Declared.isDeclaration() && Declared.use_empty())
+                Declared.eraseFromParent();
+        }
+        for (auto &Global: make_early_inc_range(PartitionModule->globals())) {
+            if (Global.isDeclaration() && Global.use_empty())
+                Global.eraseFromParent();
+        }
+        PartitionModule->setModuleIdentifier("");
+        PartitionModule->setSourceFileName("");
+
+        std::string Key = Configuration;
+        raw_string_ostream KeyStream(Key);
+        PartitionModule->print(KeyStream, nullptr);
+        Key = CompileCache::Hash(KeyStream.str());
+
+        ++Stats.Functions;
+        std::unique_ptr<MemoryBuffer> Cached = Cache.Get(Key);
+        SmallVector<char, 0> Compiled;
+        StringRef Object;
+        if (Cached) {
+            ++Stats.Reused;
+            Object = Cached->getBuffer();
+        } else {
+            raw_svector_ostream ObjectStream(Compiled);
+            if (auto Err = CompileObject(*PartitionModule, Machine, ObjectStream, Level, VectorLibrary)) {
+                RemoveObjects();
+                return Err;
+            }
+            Object = StringRef(Compiled.data(), Compiled.size());
+            Cache.Store(Key, Object);
+        }
+
+        SmallString<128> Path;
+        if (auto ErrorCode = sys::fs::createTemporaryFile("solid", "o", Path)) {
+            RemoveObjects();
+            return errorCodeToError(ErrorCode);
+        }
+        Objects.push_back(Path.str().str());
+        if (auto Err = WriteFile(Path, Object)) {
+            RemoveObjects();
+            return Err;
+        }
+    }
+
+    // once for all objects stored, instead of scanning the cache directory for every one of them
+    if (Stats.Reused < Stats.Functions)
+        Cache.Evict();
+
+    auto Link = [&]() -> Error {
+        if (Objects.empty()) {
+            // an empty object for a program without functions, like without the cache
+            std::error_code ErrorCode;
+            raw_fd_ostream Out(OutputFile, ErrorCode, sys::fs::OF_None);
+            if (ErrorCode)
+                return errorCodeToError(ErrorCode);
+            return CompileObject(Module, Machine, Out, Level, VectorLibrary);
+        }
+
+        if (Objects.size() == 1) {
+            auto Object = MemoryBuffer::getFile(Objects.front());
+            if (!Object)
+                return errorCodeToError(Object.getError());
+            return WriteFile(OutputFile, (*Object)->getBuffer());
+        }
+
+        return LinkObjects(Objects, OutputFile);
+    };
+
+    Error Result = Link();
+    RemoveObjects();
+    return Result;
+}
+
+Error LinkObjects(const std::vector<std::string> &Objects, StringRef OutputFile) {
+    auto Linker = sys::findProgramByName("ld");
+    if (!Linker)
+        return make_error<StringError>("ld not found, it links the object files into " + OutputFile,
+                                       inconvertibleErrorCode());
+
+    std::vector<StringRef> Arguments = {*Linker, "-r", "-o", OutputFile};
+    for (auto &Object: Objects)
+        Arguments.push_back(Object);
+
+    std::string Message;
+    if (sys::ExecuteAndWait(*Linker, Arguments, {}, {}, 0, 0, &Message) != 0)
+        return make_error<StringError>("linking " + OutputFile + " failed " + Message, inconvertibleErrorCode());
+    return Error::success();
+}
+
+Error WriteLibrary(Emit Emit, const std::vector<std::string> &Objects, const std::vector<std::string> &Names,
+                   const std::vector<ExportedFunction> &Functions, StringRef OutputFile, StringRef RuntimeDirectory,
+                   TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    switch (Emit) {
+        case Emit::Object:
+            return LinkObjects(Objects, OutputFile);
+        case Emit::Shared:
+            return LinkSharedLibrary(Objects, Functions, OutputFile, RuntimeDirectory, VectorLibrary);
+        case Emit::Archive:
+            return WriteArchive(Objects, Names, OutputFile);
+    }
+    llvm_unreachable("unknown output");
+}
+
+Error WriteHeader(const std::vector<ExportedFunction> &Functions, StringRef OutputFile) {
+    SmallString<128> HeaderFile(OutputFile);
+    sys::path::replace_extension(HeaderFile, "h");
+
+    std::string Guard = "SOLID_";
+    for (char Character: sys::path::stem(OutputFile))
+        Guard += isalnum((unsigned char) Character) ? (char) toupper((unsigned char) Character) : '_';
+    Guard += "_H";
+
+    std::string Header = "// Generated by solid_lang: the functions of " + sys::path::filename(OutputFile).str() + "\n\n";
+    Header += "#ifndef " + Guard + "\n#define " + Guard + "\n\n#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n";
+    for (auto &Function: Functions) {
+        Header += "double " + Function.Name + "(";
+        for (size_t i = 0; i < Function.Arguments.size(); ++i)
+            Header += (i ? ", double " : "double ") + Function.Arguments[i];
+        Header += Function.Arguments.empty() ? "void);\n" : ");\n";
+    }
+    Header += "\n#ifdef __cplusplus\n}\n#endif\n\n#endif\n";
+
+    return WriteFile(HeaderFile, Header);
+}
@@ -0,0 +1,68 @@
+#ifndef SOLID_LANG_OBJECTCOMPILER_H
+#define SOLID_LANG_OBJECTCOMPILER_H
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <string>
+#include <vector>
+#include "CompileCache.h"
+
+using namespace llvm;
+
+// What object files are packaged into
+enum class Emit {
+    // a relocatable object file, linked with the runtime library
+    Object,
+    // a shared library to dlopen, which loads the shared runtime library
+    Shared,
+    // a static archive, linked with the runtime library
+    Archive,
+};
+
+// Function of a program, declared in its header
+struct ExportedFunction {
+    std::string Name;
+    std::vector<std::string> Arguments;
+};
+
+// Compiles Module into an object file: links in the runtime bitcode (if any), runs LLVM's pipeline of Level (from O2)
+// and generates machine code at Level. The function passes (O1 and up) have already run on the functions of Module.
+// Loops the pipeline vectorizes call the vector math functions of VectorLibrary (if any).
+Error CompileObject(Module &Module, TargetMachine &Machine, raw_pwrite_stream &Object,
+                    OptimizationLevel Level = OptimizationLevel::O2,
+                    TargetLibraryInfoImpl::VectorLibrary VectorLibrary = TargetLibraryInfoImpl::NoLibrary);
+
+struct IncrementalStats {
+    unsigned Functions = 0;
+    unsigned Reused = 0;
+};
+
+// Compiles every function of Module (with the internal and prelude functions it uses, like its parallel loop bodies) into an object
+// of its own and links them into OutputFile. Objects are cached by the function's IR, which reflects its AST as well as
+// the declarations of the functions it calls and the operator precedences it was parsed with, so only functions that
+// changed since an earlier build are compiled again. Functions can't be inlined into each other.
+Error CompileObjectIncrementally(Module &Module, TargetMachine &Machine, CompileCache &Cache, StringRef OutputFile,
+                                 IncrementalStats &Stats, OptimizationLevel Level = OptimizationLevel::O2,
+                                 TargetLibraryInfoImpl::VectorLibrary VectorLibrary = TargetLibraryInfoImpl::NoLibrary);
+
+// Links object files into one with `ld -r`
+Error LinkObjects(const std::vector<std::string> &Objects, StringRef OutputFile);
+
+// Packages object files into a shared library, which only exports Functions, or into a static archive of the objects
+// (named by Names). Shared libraries don't contain the runtime, it has state (like
+// the threads of parallel loops) that has to outlive libraries which are unloaded and loaded again. They load the
+// shared runtime library instead, once for all of them: from RuntimeDirectory, or from their own directory without one.
+// Shared libraries are linked with the vector math library their objects were compiled for, if it isn't part of libm.
+Error WriteLibrary(Emit Emit, const std::vector<std::string> &Objects, const std::vector<std::string> &Names,
+                   const std::vector<ExportedFunction> &Functions, StringRef OutputFile,
+                   StringRef RuntimeDirectory = "",
+                   TargetLibraryInfoImpl::VectorLibrary VectorLibrary = TargetLibraryInfoImpl::NoLibrary);
+
+// Writes a C/C++ header declaring Functions, named like the library or object file it belongs to (`a.so` gets `a.h`)
+Error WriteHeader(const std::vector<ExportedFunction> &Functions, StringRef OutputFile);
+
+#endif
@@ -0,0 +1,33 @@
+#include "llvm/Passes/PassBuilder.h"
+#include "CompileStats.h"
+#include "Optimizer.h"
+
+void RunOptimizationPipeline(Module &Module, OptimizationLevel Level, TargetMachine *Machine,
+                             TargetLibraryInfoImpl::VectorLibrary VectorLibrary) {
+    PhaseTimer Timer(Phase::OptimizationPipeline);
+    std::unique_lock<std::mutex> PassTimingLock;
+    PassInstrumentationCallbacks *PassTiming = GetPassTimingCallbacks(PassTimingLock);
+
+    LoopAnalysisManager LoopAnalyses;
+    FunctionAnalysisManager FunctionAnalyses;
+    CGSCCAnalysisManager CGSCCAnalyses;
+    ModuleAnalysisManager ModuleAnalyses;
+
+    // registered before the default one, which it replaces
+    Triple Triple(Machine ? Machine->getTargetTriple() : llvm::Triple(Module.getTargetTriple()));
+    TargetLibraryInfoImpl LibraryInfo(Triple);
+    LibraryInfo.addVectorizableFunctionsFromVecLib(VectorLibrary, Triple);
+    FunctionAnalyses.registerPass([&] { return TargetLibraryAnalysis(LibraryInfo); });
+
+    PassBuilder Builder(Machine, PipelineTuningOptions(), {}, PassTiming);
+    Builder.registerModuleAnalyses(ModuleAnalyses);
+    Builder.registerCGSCCAnalyses(CGSCCAnalyses);
+    Builder.registerFunctionAnalyses(FunctionAnalyses);
+    Builder.registerLoopAnalyses(LoopAnalyses);
+    Builder.crossRegisterProxies(LoopAnalyses, FunctionAnalyses, CGSCCAnalyses, ModuleAnalyses);
+
+    ModulePassManager PassManager = Level == OptimizationLevel::O0
+                                    ? Builder.buildO0DefaultPipeline(Level)
+                                    : Builder.buildPerModuleDefaultPipeline(Level);
+    PassManager.run(Module, ModuleAnalyses);
+}
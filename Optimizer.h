@@ -0,0 +1,17 @@
+#ifndef SOLID_LANG_OPTIMIZER_H
+#define SOLID_LANG_OPTIMIZER_H
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+// Runs LLVM's default per-module pipeline (the one `clang -O<n>` uses) on the given module.
+// Passing the target machine lets the pipeline use target specific cost models (e.g. for vectorization).
+// With a vector library, loops calling math functions can be vectorized with the library's vector variants.
+void RunOptimizationPipeline(Module &Module, OptimizationLevel Level, TargetMachine *Machine = nullptr,
+                             TargetLibraryInfoImpl::VectorLibrary VectorLibrary = TargetLibraryInfoImpl::NoLibrary);
+
+#endif
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "OutputRuntime.h"
+
+namespace {
+
+const size_t BufferSize = 64 * 1024;
+
+struct Buffer {
+    std::mutex Mutex;
+    char Data[BufferSize];
+    size_t Size = 0;
+};
+
+// Lock order: Buffers, then a buffer's mutex, then Sink. Writing to a thread's own buffer only takes its mutex,
+// which no other thread holds unless it flushes everything.
+class Output {
+    std::mutex BuffersMutex;
+    std::vector<Buffer *> Buffers;
+
+    std::mutex SinkMutex;
+    FILE *Sink = stderr;
+    bool OwnsSink = false;
+
+    std::atomic<bool> Binary{false};
+
+public:
+    Output() {
+        if (const char *Name = getenv("SOLID_OUTPUT"))
+            Open(Name);
+
+        const char *Format = getenv("SOLID_OUTPUT_FORMAT");
+        Binary = Format && std::string(Format) == "binary";
+
+        // for threads that are still running when the program exits, the others flush when they exit
+        atexit([]() { Get().FlushAll(); });
+    }
+
+    // never destroyed, threads may still flush while the program exits
+    static Output &Get() {
+        static Output *Instance = new Output();
+        return *Instance;
+    }
+
+    bool IsBinary() const {
+        return Binary.load(std::memory_order_relaxed);
+    }
+
+    void Register(Buffer *Buffer) {
+        std::lock_guard<std::mutex> Lock(BuffersMutex);
+        Buffers.push_back(Buffer);
+    }
+
+    void Unregister(Buffer *Buffer) {
+        std::lock_guard<std::mutex> Lock(BuffersMutex);
+        {
+            std::lock_guard<std::mutex> BufferLock(Buffer->Mutex);
+            Flush(*Buffer);
+        }
+        Buffers.erase(std::find(Buffers.begin(), Buffers.end(), Buffer));
+    }
+
+    void Append(Buffer &Buffer, const char *Data, size_t Size) {
+        std::lock_guard<std::mutex> Lock(Buffer.Mutex);
+        if (Buffer.Size + Size > BufferSize) {
+            Flush(Buffer);
+
+            // too big to buffer
+            if (Size > BufferSize) {
+                Write(Data, Size);
+                return;
+            }
+        }
+
+        memcpy(Buffer.Data + Buffer.Size, Data, Size);
+        Buffer.Size += Size;
+    }
+
+    void FlushAll() {
+        std::lock_guard<std::mutex> Lock(BuffersMutex);
+        for (auto *Buffer: Buffers) {
+            std::lock_guard<std::mutex> BufferLock(Buffer->Mutex);
+            Flush(*Buffer);
+        }
+
+        std::lock_guard<std::mutex> SinkLock(SinkMutex);
+        fflush(Sink);
+    }
+
+    bool Open(const char *Name) {
+        FILE *Next;
+        bool OwnsNext = false;
+        if (strcmp(Name, "stdout") == 0) {
+            Next = stdout;
+        } else if (strcmp(Name, "stderr") == 0) {
+            Next = stderr;
+        } else {
+            Next = fopen(Name, "wb");
+            if (!Next)
+                return false;
+            OwnsNext = true;
+        }
+
+        std::lock_guard<std::mutex> Lock(SinkMutex);
+        if (OwnsSink)
+            fclose(Sink);
+        Sink = Next;
+        OwnsSink = OwnsNext;
+        return true;
+    }
+
+    void SetBinary(bool IsBinary) {
+        Binary.store(IsBinary, std::memory_order_relaxed);
+    }
+
+private:
+    void Flush(Buffer &Buffer) {
+        if (Buffer.Size == 0)
+            return;
+
+        Write(Buffer.Data, Buffer.Size);
+        Buffer.Size = 0;
+    }
+
+    void Write(const char *Data, size_t Size) {
+        std::lock_guard<std::mutex> Lock(SinkMutex);
+        fwrite(Data, 1, Size, Sink);
+    }
+};
+
+struct ThreadBuffer {
+    Buffer *Buffer = new struct Buffer();
+
+    ThreadBuffer() {
+        Output::Get().Register(Buffer);
+    }
+
+    ~ThreadBuffer() {
+        Output::Get().Unregister(Buffer);
+        delete Buffer;
+    }
+};
+
+Buffer &GetThreadBuffer() {
+    thread_local ThreadBuffer Local;
+    return *Local.Buffer;
+}
+
+}
+
+void __solid_flush_output() {
+    Output::Get().FlushAll();
+}
+
+int __solid_set_output(const char *Sink) {
+    __solid_flush_output();
+    return Output::Get().Open(Sink) ? 0 : -1;
+}
+
+void __solid_set_output_binary(int Binary) {
+    __solid_flush_output();
+    Output::Get().SetBinary(Binary != 0);
+}
+
+void __solid_write(const char *Data, size_t Size) {
+    Output::Get().Append(GetThreadBuffer(), Data, Size);
+}
+
+void __solid_write_double(double Value) {
+    if (Output::Get().IsBinary()) {
+        __solid_write(reinterpret_cast<const char *>(&Value), sizeof(Value));
+        return;
+    }
+
+    // shortest representation that reads back as the same double
+    char Text[32];
+#ifdef __cpp_lib_to_chars
+    char *End = std::to_chars(Text, Text + sizeof(Text) - 1, Value).ptr;
+#else
+    char *End = Text + snprintf(Text, sizeof(Text) - 1, "%.17g", Value);
+#endif
+    *End++ = '\n';
+    __solid_write(Text, End - Text);
+}
@@ -0,0 +1,30 @@
+#ifndef SOLID_LANG_OUTPUTRUNTIME_H
+#define SOLID_LANG_OUTPUTRUNTIME_H
+
+#include <cstddef>
+
+// Output of the `print`, `printc` and `flush` built-ins. Every thread appends to its own buffer, which is written to
+// the sink when it's full, on `flush` and when the thread or the program exits.
+// Sink: SOLID_OUTPUT (`stderr` by default, `stdout` or the path of a file), format: SOLID_OUTPUT_FORMAT (`text` by
+// default, or `binary` for the raw 8 bytes of every printed number).
+
+extern "C" {
+
+// Writes the buffers of all threads to the sink.
+void __solid_flush_output();
+
+// Flushes and switches the sink to `stdout`, `stderr` or a file (created or truncated). Returns 0 on success.
+int __solid_set_output(const char *Sink);
+
+// Flushes and switches between text (0) and binary (1) output.
+void __solid_set_output_binary(int Binary);
+
+// Appends Size bytes to the calling thread's buffer.
+void __solid_write(const char *Data, size_t Size);
+
+// Appends the shortest text that reads back as Value and a newline, or its 8 bytes in binary mode.
+void __solid_write_double(double Value);
+
+}
+
+#endif
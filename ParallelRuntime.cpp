@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ParallelRuntime.h"
+
+namespace {
+
+struct Loop {
+    double Start;
+    double Step;
+    SolidLoopBody Body;
+    void *Context;
+    // chunks that haven't finished yet
+    std::atomic<uint64_t> Remaining{0};
+};
+
+struct Call {
+    SolidSpawnedCall Function;
+    std::vector<double> Arguments;
+    double *Result;
+    std::atomic<uint64_t> *Pending;
+};
+
+// generated code only sees the group's size
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(SolidTaskGroup), "task groups are atomic counters");
+
+// a chunk of a loop's iterations or a spawned call
+struct Task {
+    struct Loop *Loop;
+    uint64_t Begin;
+    uint64_t End;
+    struct Call *Call;
+};
+
+// chunks of a parallel loop queued per worker, at most
+const uint64_t MaxChunksPerWorker = 64;
+
+// Every worker owns a deque of tasks: it takes the newest tasks of its own deque (which are the hottest in its
+// cache) and steals the oldest ones of the others when it runs out. For divide and conquer code, the oldest calls are
+// the biggest ones.
+class WorkStealingPool {
+    struct Worker {
+        std::mutex Mutex;
+        std::deque<Task> Tasks;
+        // size of Tasks, read without the lock by the serial cutoff
+        std::atomic<uint64_t> Size{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> Workers;
+    std::vector<std::thread> Threads;
+
+    // wakes up sleeping workers when chunks are queued
+    std::mutex SleepMutex;
+    std::condition_variable WorkAvailable;
+    std::atomic<uint64_t> Queued{0};
+    bool Stopping = false;
+
+    // index of the worker running on this thread, the others start stealing at a different worker each time
+    static thread_local int WorkerIndex;
+    std::atomic<unsigned> NextVictim{0};
+
+    uint64_t ChunkSize;
+    uint64_t SpawnCutoff;
+
+public:
+    WorkStealingPool(unsigned ThreadCount, uint64_t ChunkSize, uint64_t SpawnCutoff)
+            : ChunkSize(ChunkSize), SpawnCutoff(SpawnCutoff) {
+        for (unsigned i = 0; i < ThreadCount; ++i)
+            Workers.push_back(std::make_unique<Worker>());
+
+        // the thread running a loop helps with it, so one thread less is started
+        for (unsigned i = 1; i < ThreadCount; ++i)
+            Threads.emplace_back([this, i]() { Run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> Lock(SleepMutex);
+            Stopping = true;
+        }
+        WorkAvailable.notify_all();
+
+        for (auto &Thread: Threads)
+            Thread.join();
+    }
+
+    unsigned GetThreadCount() const {
+        return Workers.size();
+    }
+
+    void RunLoop(Loop &Loop, uint64_t Iterations) {
+        uint64_t Size = ChunkSize;
+        if (Size == 0)
+            Size = std::max<uint64_t>(1, Iterations / (Workers.size() * 4));
+
+        // all chunks are queued up front, small chunk sizes are raised for big loops to keep them in memory
+        uint64_t MaxChunkCount = Workers.size() * MaxChunksPerWorker;
+        Size = std::max(Size, (Iterations + MaxChunkCount - 1) / MaxChunkCount);
+
+        uint64_t ChunkCount = (Iterations + Size - 1) / Size;
+        Loop.Remaining = ChunkCount;
+
+        // deal the chunks out round robin, starting with this thread's own deque
+        unsigned First = WorkerIndex >= 0 ? WorkerIndex : 0;
+        for (uint64_t i = 0; i < ChunkCount; ++i) {
+            Task Chunk = {&Loop, i * Size, std::min(Iterations, (i + 1) * Size), nullptr};
+            Push(*Workers[(First + i) % Workers.size()], Chunk);
+        }
+
+        {
+            std::lock_guard<std::mutex> Lock(SleepMutex);
+            Queued += ChunkCount;
+        }
+        WorkAvailable.notify_all();
+
+        // help until the loop is done, which also runs chunks of other loops (nested ones in particular)
+        WaitFor(Loop.Remaining, First);
+    }
+
+    void Spawn(std::atomic<uint64_t> &Pending, SolidSpawnedCall Function, const double *Arguments,
+               uint32_t ArgumentCount, double *Result) {
+        unsigned Own = WorkerIndex >= 0 ? WorkerIndex : 0;
+        auto &Worker = *Workers[Own];
+
+        // serial cutoff: while this thread has enough queued tasks to feed the others, calls run inline
+        if (Workers.size() == 1 || Worker.Size.load(std::memory_order_relaxed) >= SpawnCutoff) {
+            double Discarded;
+            Function(Arguments, Result ? Result : &Discarded);
+            return;
+        }
+
+        Pending.fetch_add(1, std::memory_order_relaxed);
+        Push(Worker, {nullptr, 0, 0,
+                      new Call{Function, std::vector<double>(Arguments, Arguments + ArgumentCount), Result, &Pending}});
+
+        {
+            std::lock_guard<std::mutex> Lock(SleepMutex);
+            Queued++;
+        }
+        WorkAvailable.notify_one();
+    }
+
+    void Sync(std::atomic<uint64_t> &Pending) {
+        WaitFor(Pending, WorkerIndex >= 0 ? WorkerIndex : 0);
+    }
+
+private:
+    void Run(unsigned Index) {
+        WorkerIndex = (int) Index;
+
+        while (true) {
+            if (RunTask(Index))
+                continue;
+
+            std::unique_lock<std::mutex> Lock(SleepMutex);
+            WorkAvailable.wait(Lock, [this]() { return Stopping || Queued.load() != 0; });
+            if (Stopping)
+                return;
+        }
+    }
+
+    void WaitFor(std::atomic<uint64_t> &Remaining, unsigned Index) {
+        while (Remaining.load(std::memory_order_acquire) != 0) {
+            if (!RunTask(Index))
+                std::this_thread::yield();
+        }
+    }
+
+    bool RunTask(unsigned Index) {
+        Task Next;
+        if (!Pop(*Workers[Index], Next, true)) {
+            unsigned Victim = NextVictim++;
+            bool Stolen = false;
+            for (unsigned i = 0; i < Workers.size() && !Stolen; ++i)
+                Stolen = Pop(*Workers[(Victim + i) % Workers.size()], Next, false);
+            if (!Stolen)
+                return false;
+        }
+
+        Queued--;
+
+        if (Next.Call) {
+            std::unique_ptr<Call> Call(Next.Call);
+            double Discarded;
+            Call->Function(Call->Arguments.data(), Call->Result ? Call->Result : &Discarded);
+            Call->Pending->fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        auto &Loop = *Next.Loop;
+        for (uint64_t i = Next.Begin; i < Next.End; ++i)
+            Loop.Body(Loop.Context, Loop.Start + (double) i * Loop.Step);
+
+        Loop.Remaining.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    static void Push(Worker &Worker, Task Next) {
+        std::lock_guard<std::mutex> Lock(Worker.Mutex);
+        Worker.Tasks.push_back(Next);
+        Worker.Size.store(Worker.Tasks.size(), std::memory_order_relaxed);
+    }
+
+    static bool Pop(Worker &Worker, Task &Result, bool Newest) {
+        std::lock_guard<std::mutex> Lock(Worker.Mutex);
+        if (Worker.Tasks.empty())
+            return false;
+
+        if (Newest) {
+            Result = Worker.Tasks.back();
+            Worker.Tasks.pop_back();
+        } else {
+            Result = Worker.Tasks.front();
+            Worker.Tasks.pop_front();
+        }
+        Worker.Size.store(Worker.Tasks.size(), std::memory_order_relaxed);
+        return true;
+    }
+};
+
+thread_local int WorkStealingPool::WorkerIndex = -1;
+
+uint64_t GetEnvironmentValue(const char *Name, uint64_t Default) {
+    const char *Value = getenv(Name);
+    if (!Value || !*Value)
+        return Default;
+    return strtoull(Value, nullptr, 10);
+}
+
+// iterations of a parallel loop, far more than can run; counting and splitting them can't overflow
+const uint64_t MaxIterations = (uint64_t) 1 << 62;
+
+WorkStealingPool &GetPool() {
+    static WorkStealingPool Pool(
+            std::max<uint64_t>(1, GetEnvironmentValue("SOLID_NUM_THREADS", std::thread::hardware_concurrency())),
+            GetEnvironmentValue("SOLID_CHUNK_SIZE", 0),
+            GetEnvironmentValue("SOLID_SPAWN_CUTOFF", 8));
+    return Pool;
+}
+
+}
+
+void __solid_parallel_while(double Start, double End, double Step, SolidLoopBody Body, void *Context) {
+    // like `while`, which checks the condition after the body with the variable's value before the step
+    uint64_t Iterations = 1;
+    if (Start < End && Step > 0) {
+        double Steps = std::ceil((End - Start) / Step);
+
+        // infinite ranges and steps, tiny steps and NaN (inf / inf) can't be counted nor split (0 * inf is NaN), they
+        // run like `while`
+        if (!std::isfinite(Steps) || Steps >= (double) MaxIterations || !std::isfinite(Step)) {
+            for (double Variable = Start;; Variable += Step) {
+                Body(Context, Variable);
+                if (!(Variable < End))
+                    return;
+            }
+        }
+        Iterations += (uint64_t) Steps;
+    }
+
+    auto &Pool = GetPool();
+    if (Pool.GetThreadCount() == 1 || Iterations == 1) {
+        for (uint64_t i = 0; i < Iterations; ++i)
+            Body(Context, Start + (double) i * Step);
+        return;
+    }
+
+    Loop Loop;
+    Loop.Start = Start;
+    Loop.Step = Step;
+    Loop.Body = Body;
+    Loop.Context = Context;
+    Pool.RunLoop(Loop, Iterations);
+}
+
+void __solid_spawn(SolidTaskGroup *Group, SolidSpawnedCall Call, const double *Arguments, uint32_t ArgumentCount,
+                   double *Result) {
+    GetPool().Spawn(*reinterpret_cast<std::atomic<uint64_t> *>(Group), Call, Arguments, ArgumentCount, Result);
+}
+
+void __solid_sync(SolidTaskGroup *Group) {
+    GetPool().Sync(*reinterpret_cast<std::atomic<uint64_t> *>(Group));
+}
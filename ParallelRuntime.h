@@ -0,0 +1,36 @@
+#ifndef SOLID_LANG_PARALLELRUNTIME_H
+#define SOLID_LANG_PARALLELRUNTIME_H
+
+#include <cstdint>
+
+// Runtime of `parallel while` loops and `spawn`/`sync`. It's linked into the compiler for JIT'd code and shipped as
+// the static library solid_runtime for object files. Threads: SOLID_NUM_THREADS (default: one per core, including the
+// calling thread), iterations per chunk: SOLID_CHUNK_SIZE (default: enough for a few chunks per thread), queued calls
+// per thread before spawned calls run inline: SOLID_SPAWN_CUTOFF (default: 8).
+
+extern "C" {
+
+// Loop body outlined by the IR generator, Context holds the values of the variables it uses
+typedef void (*SolidLoopBody)(void *Context, double Index);
+
+// Runs Body for Index = Start, Start + Step, ... as often as `while Index < End` would run it (so at least once),
+// in chunks spread over the worker threads. Returns when all iterations are done. Step has to be positive.
+void __solid_parallel_while(double Start, double End, double Step, SolidLoopBody Body, void *Context);
+
+// The calls spawned by one function call, which `sync` waits for. Generated code keeps it on the stack, set to 0.
+typedef uint64_t SolidTaskGroup;
+
+// Generated for every spawned function: calls it with the arguments and stores its result
+typedef void (*SolidSpawnedCall)(const double *Arguments, double *Result);
+
+// Queues Call(Arguments, Result) for the worker threads, or runs it right away when the calling thread has queued
+// enough calls already. The arguments are copied, Result (if any) is written when `__solid_sync(Group)` returns.
+void __solid_spawn(SolidTaskGroup *Group, SolidSpawnedCall Call, const double *Arguments, uint32_t ArgumentCount,
+                   double *Result);
+
+// Returns when all calls spawned into Group are done, running queued work in the meantime.
+void __solid_sync(SolidTaskGroup *Group);
+
+}
+
+#endif
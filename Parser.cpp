@@ -1,3 +1,4 @@
+#include "CompileStats.h"
 #include "Parser.h"
 
 std::unique_ptr<Expression> Parser::ParseExpression() {
@@ -19,8 +20,15 @@ std::unique_ptr<Expression> Parser::ParsePrimaryExpression() {
             return ParseConditionalExpression();
         case t_while:
             return ParseLoopExpression();
+        case t_parallel:
+            return ParseParallelLoopExpression();
         case t_let:
             return ParseVariableDefinition();
+        case t_spawn:
+            return ParseSpawnExpression();
+        case t_sync:
+            Lexer.GetNextToken(); // consume 'sync'
+            return std::make_unique<SyncExpression>();
         default:
             return LogError<Expression>("unknown token while parsing expression");
     }
@@ -30,6 +38,18 @@ std::unique_ptr<Expression> Parser::ParseIdExpression() {
     auto Name = Lexer.GetIdVal();
     Lexer.GetNextToken(); // consume id
 
+    // reduction loops: ('sum' | 'product' | 'min' | 'max') 'while' ..., which are only keywords in front of 'while'
+    if (Lexer.GetCurrentToken() == t_while) {
+        if (Name == "sum")
+            return ParseLoopExpression(false, Reduction::Sum);
+        if (Name == "product")
+            return ParseLoopExpression(false, Reduction::Product);
+        if (Name == "min")
+            return ParseLoopExpression(false, Reduction::Min);
+        if (Name == "max")
+            return ParseLoopExpression(false, Reduction::Max);
+    }
+
     if (Lexer.GetCurrentToken() != '(') // if it's not a function call then it's just a variable
         return std::make_unique<VariableExpression>(Name);
 
@@ -118,7 +138,7 @@ std::unique_ptr<Expression> Parser::ParseConditionalExpression() {
 }
 
 /// parse: 'while' expr 'let' id '=' expr ('step' expr)? 'do' expr
-std::unique_ptr<Expression> Parser::ParseLoopExpression() {
+std::unique_ptr<Expression> Parser::ParseLoopExpression(bool Parallel, enum Reduction Reduction) {
     Lexer.GetNextToken(); // consume 'while'
 
     auto While = ParseExpression();
@@ -164,7 +184,36 @@ std::unique_ptr<Expression> Parser::ParseLoopExpression() {
         return nullptr;
     }
 
-    return std::make_unique<LoopExpression>(Name, std::move(Let), std::move(While), std::move(Step), std::move(Body));
+    return std::make_unique<LoopExpression>(Name, std::move(Let), std::move(While), std::move(Step), std::move(Body),
+                                            Parallel, Reduction);
+}
+
+/// parse: 'parallel' 'while' expr 'let' id '=' expr ('step' expr)? 'do' expr
+std::unique_ptr<Expression> Parser::ParseParallelLoopExpression() {
+    Lexer.GetNextToken(); // consume 'parallel'
+
+    if (Lexer.GetCurrentToken() != t_while)
+        return LogError<Expression>("expected 'while'");
+
+    return ParseLoopExpression(true);
+}
+
+/// parse: 'spawn' id '(' (expr (',' expr)*)? ')'
+std::unique_ptr<Expression> Parser::ParseSpawnExpression() {
+    Lexer.GetNextToken(); // consume 'spawn'
+
+    if (Lexer.GetCurrentToken() != t_id)
+        return LogError<Expression>("expected function call after 'spawn'");
+
+    auto Call = ParseIdExpression();
+    if (!Call)
+        return nullptr;
+
+    if (!dynamic_cast<FunctionCall *>(Call.get()))
+        return LogError<Expression>("expected function call after 'spawn'");
+
+    return std::make_unique<SpawnExpression>(
+            std::unique_ptr<FunctionCall>(static_cast<FunctionCall *>(Call.release())));
 }
 
 /// parse: 'let' id ('=' expr)? (',' id ('=' expr)?)* 'in' expr
@@ -255,7 +304,7 @@ std::unique_ptr<Expression> Parser::ParseRightSideOfBinaryOperator(int Expressio
     }
 }
 
-std::unique_ptr<FunctionDeclaration> Parser::ParseFunctionDeclaration() {
+std::unique_ptr<FunctionDeclaration> Parser::ParseFunctionDeclaration(bool Native) {
     std::string Name;
     int Type; // 0 = id, 1 = unary, 2 = binary
 
@@ -311,21 +360,76 @@ std::unique_ptr<FunctionDeclaration> Parser::ParseFunctionDeclaration() {
         return LogError<FunctionDeclaration>("expected '('");
 
     std::vector<std::string> ArgumentNames;
-    while (Lexer.GetNextToken() == t_id)
+    std::vector<NativeType> ArgumentTypes;
+    bool Typed = false;
+    Lexer.GetNextToken(); // consume '('
+    while (Lexer.GetCurrentToken() == t_id) {
         ArgumentNames.push_back(Lexer.GetIdVal());
+        Lexer.GetNextToken(); // consume argument name
+
+        // natives may declare the C type of arguments, `x: i32`
+        NativeType ArgumentType = NativeType::F64;
+        if (Native && Lexer.GetCurrentToken() == ':') {
+            Lexer.GetNextToken(); // consume ':'
+            auto Parsed = ParseNativeType();
+            if (!Parsed)
+                return nullptr;
+            if (*Parsed == NativeType::Void)
+                return LogError<FunctionDeclaration>("arguments can't be void");
+            ArgumentType = *Parsed;
+            Typed = true;
+        }
+        ArgumentTypes.push_back(ArgumentType);
+    }
 
     if (Lexer.GetCurrentToken() != ')')
         return LogError<FunctionDeclaration>("expected ')'");
 
     Lexer.GetNextToken(); // consume ')'
 
+    // and of the result, `: i32`
+    NativeType ReturnType = NativeType::F64;
+    if (Native && Lexer.GetCurrentToken() == ':') {
+        Lexer.GetNextToken(); // consume ':'
+        auto Parsed = ParseNativeType();
+        if (!Parsed)
+            return nullptr;
+        ReturnType = *Parsed;
+        Typed = true;
+    }
+
     if ((Type == 1 && ArgumentNames.size() != 1) || (Type == 2 && ArgumentNames.size() != 2))
         return LogError<FunctionDeclaration>("invalid number of operands for unary/binary operator");
 
-    return std::make_unique<FunctionDeclaration>(Name, std::move(ArgumentNames));
+    if (Type != 0 && Typed)
+        return LogError<FunctionDeclaration>("operators can't have types");
+
+    auto Declaration = std::make_unique<FunctionDeclaration>(Name, std::move(ArgumentNames));
+    if (Native)
+        Declaration->SetNative(std::move(ArgumentTypes), ReturnType);
+    return Declaration;
+}
+
+std::optional<NativeType> Parser::ParseNativeType() {
+    static const std::map<std::string, NativeType> Types = {{"f64",  NativeType::F64},
+                                                            {"f32",  NativeType::F32},
+                                                            {"i64",  NativeType::I64},
+                                                            {"i32",  NativeType::I32},
+                                                            {"ptr",  NativeType::Ptr},
+                                                            {"void", NativeType::Void}};
+
+    auto Type = Lexer.GetCurrentToken() == t_id ? Types.find(Lexer.GetIdVal()) : Types.end();
+    if (Type == Types.end()) {
+        OnError("expected type (f64, f32, i64, i32, ptr or void)");
+        return std::nullopt;
+    }
+
+    Lexer.GetNextToken(); // consume type
+    return Type->second;
 }
 
 std::unique_ptr<FunctionDefinition> Parser::ParseFunctionDefinition() {
+    PhaseTimer Timer(Phase::Parsing);
     Lexer.GetNextToken(); // consume 'func'/'operator'
     auto Declaration = ParseFunctionDeclaration();
     if (!Declaration)
@@ -339,11 +443,13 @@ std::unique_ptr<FunctionDefinition> Parser::ParseFunctionDefinition() {
 }
 
 std::unique_ptr<FunctionDeclaration> Parser::ParseNative() {
+    PhaseTimer Timer(Phase::Parsing);
     Lexer.GetNextToken(); // consume 'native'
-    return ParseFunctionDeclaration();
+    return ParseFunctionDeclaration(true);
 }
 
 std::unique_ptr<FunctionDefinition> Parser::ParseTopLevelExpression() {
+    PhaseTimer Timer(Phase::Parsing);
     auto Body = ParseExpression();
     if (!Body)
         return nullptr;
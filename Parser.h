@@ -3,13 +3,15 @@
 
 #include <utility>
 #include <map>
+#include <optional>
 
+#include "ErrorHandler.h"
 #include "Lexer.h"
 #include "Expression.h"
 
 class Parser {
 public:
-    explicit Parser(Lexer &Lexer) : Lexer(Lexer) {}
+    explicit Parser(Lexer &Lexer, ErrorHandler OnError = PrintError) : Lexer(Lexer), OnError(std::move(OnError)) {}
 
     std::unique_ptr<Expression> ParseExpression();
 
@@ -25,11 +27,17 @@ public:
 
     std::unique_ptr<Expression> ParseConditionalExpression();
 
-    std::unique_ptr<Expression> ParseLoopExpression();
+    std::unique_ptr<Expression> ParseLoopExpression(bool Parallel = false, Reduction Reduction = Reduction::None);
+
+    std::unique_ptr<Expression> ParseParallelLoopExpression();
+
+    std::unique_ptr<Expression> ParseSpawnExpression();
 
     std::unique_ptr<Expression> ParseVariableDefinition();
 
-    std::unique_ptr<FunctionDeclaration> ParseFunctionDeclaration();
+    std::unique_ptr<FunctionDeclaration> ParseFunctionDeclaration(bool Native = false);
+
+    std::optional<NativeType> ParseNativeType();
 
     std::unique_ptr<FunctionDefinition> ParseFunctionDefinition();
 
@@ -39,6 +47,7 @@ public:
 
 private:
     Lexer &Lexer;
+    ErrorHandler OnError;
     std::map<char, int> BinaryOperatorPrecedences = {{'*', 40},
                                                      {'+', 20},
                                                      {'-', 20},
@@ -51,7 +60,7 @@ private:
 
     template<class T>
     std::unique_ptr<T> LogError(const char *Message) {
-        fprintf(stderr, "Error: %s\n", Message);
+        OnError(Message);
         return nullptr;
     }
 };
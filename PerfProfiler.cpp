@@ -0,0 +1,221 @@
+#include "llvm/ADT/Triple.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/TargetParser/Host.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include "PerfProfiler.h"
+
+#ifdef LLVM_ON_UNIX
+#include <sys/mman.h>
+#endif
+
+// Record layouts of the jitdump format, see tools/perf/Documentation/jitdump-specification.txt in the Linux sources
+namespace {
+
+const uint32_t JitDumpMagic = 0x4A695444;
+const uint32_t JitDumpVersion = 1;
+
+enum JitDumpRecordType : uint32_t {
+    JitCodeLoad = 0,
+    JitCodeClose = 3,
+};
+
+struct JitDumpHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t TotalSize;
+    uint32_t ElfMachine;
+    uint32_t Padding;
+    uint32_t Pid;
+    uint64_t Timestamp;
+    uint64_t Flags;
+};
+
+struct JitDumpRecordPrefix {
+    uint32_t Id;
+    uint32_t TotalSize;
+    uint64_t Timestamp;
+};
+
+struct JitDumpCodeLoad {
+    JitDumpRecordPrefix Prefix;
+    uint32_t Pid;
+    uint32_t Tid;
+    uint64_t Vma;
+    uint64_t CodeAddress;
+    uint64_t CodeSize;
+    uint64_t CodeIndex;
+};
+
+// perf matches these against its own samples, which use CLOCK_MONOTONIC
+uint64_t GetTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t GetElfMachine() {
+    switch (Triple(sys::getProcessTriple()).getArch()) {
+        case Triple::x86:
+            return ELF::EM_386;
+        case Triple::x86_64:
+            return ELF::EM_X86_64;
+        case Triple::arm:
+            return ELF::EM_ARM;
+        case Triple::aarch64:
+            return ELF::EM_AARCH64;
+        default:
+            return ELF::EM_NONE;
+    }
+}
+
+class PerfPlugin : public ObjectLinkingLayer::Plugin {
+    PerfProfiler &Profiler;
+
+public:
+    explicit PerfPlugin(PerfProfiler &Profiler) : Profiler(Profiler) {}
+
+    void modifyPassConfig(MaterializationResponsibility &MR, jitlink::LinkGraph &G,
+                          jitlink::PassConfiguration &Config) override {
+        // addresses are final after fixups
+        Config.PostFixupPasses.push_back([this](jitlink::LinkGraph &G) {
+            for (auto *Symbol: G.defined_symbols()) {
+                if (Symbol->hasName() && Symbol->isCallable())
+                    Profiler.Register(Symbol->getName(), Symbol->getAddress().getValue(), Symbol->getSize());
+            }
+            return Error::success();
+        });
+    }
+
+    Error notifyFailed(MaterializationResponsibility &MR) override {
+        return Error::success();
+    }
+
+    Error notifyRemovingResources(ResourceKey Key) override {
+        return Error::success();
+    }
+
+    void notifyTransferringResources(ResourceKey DstKey, ResourceKey SrcKey) override {}
+};
+
+}
+
+PerfProfiler::PerfProfiler(bool WritePerfMap, bool WriteJitDump) {
+    if (WritePerfMap) {
+        std::string Path = "/tmp/perf-" + std::to_string(sys::Process::getProcessId()) + ".map";
+        PerfMap = fopen(Path.c_str(), "w");
+        if (!PerfMap)
+            fprintf(stderr, "Error: could not open %s\n", Path.c_str());
+    }
+
+    if (WriteJitDump) {
+        OpenJitDump();
+    }
+}
+
+PerfProfiler::~PerfProfiler() {
+    if (PerfMap)
+        fclose(PerfMap);
+
+    if (JitDump)
+        CloseJitDump();
+}
+
+void PerfProfiler::OpenJitDump() {
+    const char *Directory = getenv("JITDUMPDIR");
+    uint32_t Pid = sys::Process::getProcessId();
+    std::string Path = std::string(Directory ? Directory : "/tmp") + "/jit-" + std::to_string(Pid) + ".dump";
+
+    JitDump = fopen(Path.c_str(), "w+");
+    if (!JitDump) {
+        fprintf(stderr, "Error: could not open %s\n", Path.c_str());
+        return;
+    }
+
+#ifdef LLVM_ON_UNIX
+    // perf finds the dump through this (executable) mapping of it in the recorded mmap events
+    JitDumpMarker = mmap(nullptr, sys::Process::getPageSizeEstimate(), PROT_READ | PROT_EXEC, MAP_PRIVATE,
+                         fileno(JitDump), 0);
+    if (JitDumpMarker == MAP_FAILED)
+        JitDumpMarker = nullptr;
+#endif
+
+    JitDumpHeader Header = {JitDumpMagic, JitDumpVersion, sizeof(JitDumpHeader), GetElfMachine(), 0, Pid,
+                            GetTimestamp(), 0};
+    fwrite(&Header, sizeof(Header), 1, JitDump);
+    fflush(JitDump);
+}
+
+void PerfProfiler::CloseJitDump() {
+    JitDumpRecordPrefix Close = {JitCodeClose, sizeof(JitDumpRecordPrefix), GetTimestamp()};
+    fwrite(&Close, sizeof(Close), 1, JitDump);
+
+#ifdef LLVM_ON_UNIX
+    if (JitDumpMarker)
+        munmap(JitDumpMarker, sys::Process::getPageSizeEstimate());
+#endif
+
+    fclose(JitDump);
+}
+
+void PerfProfiler::notifyObjectLoaded(ObjectKey Key, const object::ObjectFile &Object,
+                                      const RuntimeDyld::LoadedObjectInfo &Info) {
+    for (auto &SymbolAndSize: object::computeSymbolSizes(Object)) {
+        auto &Symbol = SymbolAndSize.first;
+
+        auto Type = Symbol.getType();
+        if (!Type || *Type != object::SymbolRef::ST_Function) {
+            consumeError(Type.takeError());
+            continue;
+        }
+
+        auto Name = Symbol.getName();
+        auto Address = Symbol.getAddress();
+        auto Section = Symbol.getSection();
+        if (!Name || !Address || !Section || *Section == Object.section_end()) {
+            consumeError(Name.takeError());
+            consumeError(Address.takeError());
+            consumeError(Section.takeError());
+            continue;
+        }
+
+        // symbol addresses are relative to the object file, rebase them to where the section was loaded
+        uint64_t LoadAddress = Info.getSectionLoadAddress(**Section) + (*Address - (*Section)->getAddress());
+        Register(*Name, LoadAddress, SymbolAndSize.second);
+    }
+}
+
+std::unique_ptr<ObjectLinkingLayer::Plugin> PerfProfiler::CreatePlugin() {
+    return std::make_unique<PerfPlugin>(*this);
+}
+
+void PerfProfiler::Register(StringRef Name, uint64_t Address, uint64_t Size) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    if (PerfMap) {
+        fprintf(PerfMap, "%llx %llx %s\n", (unsigned long long) Address, (unsigned long long) Size,
+                Name.str().c_str());
+        fflush(PerfMap);
+    }
+
+    if (JitDump) {
+        JitDumpCodeLoad Record;
+        Record.Prefix = {JitCodeLoad, (uint32_t) (sizeof(Record) + Name.size() + 1 + Size), GetTimestamp()};
+        Record.Pid = sys::Process::getProcessId();
+        Record.Tid = (uint32_t) get_threadid();
+        Record.Vma = Address;
+        Record.CodeAddress = Address;
+        Record.CodeSize = Size;
+        Record.CodeIndex = CodeIndex++;
+
+        fwrite(&Record, sizeof(Record), 1, JitDump);
+        fwrite(Name.data(), 1, Name.size(), JitDump);
+        fputc('\0', JitDump);
+        fwrite(reinterpret_cast<const void *>(Address), 1, Size, JitDump);
+        fflush(JitDump);
+    }
+}
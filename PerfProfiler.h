@@ -0,0 +1,45 @@
+#ifndef SOLID_LANG_PERFPROFILER_H
+#define SOLID_LANG_PERFPROFILER_H
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include <cstdio>
+#include <mutex>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Makes JIT'd functions visible to `perf`:
+// - perf map: `/tmp/perf-<pid>.map`, one "<address> <size> <name>" line per function, read by `perf report`
+// - jitdump: `jit-<pid>.dump` (in $JITDUMPDIR or /tmp) with the code of every function, for `perf inject --jit`
+// Functions are registered when they are linked, either through RuntimeDyld (as JITEventListener) or
+// JITLink (through the plugin from CreatePlugin).
+class PerfProfiler : public JITEventListener {
+
+public:
+    PerfProfiler(bool WritePerfMap, bool WriteJitDump);
+
+    ~PerfProfiler() override;
+
+    void notifyObjectLoaded(ObjectKey Key, const object::ObjectFile &Object,
+                            const RuntimeDyld::LoadedObjectInfo &Info) override;
+
+    std::unique_ptr<ObjectLinkingLayer::Plugin> CreatePlugin();
+
+    void Register(StringRef Name, uint64_t Address, uint64_t Size);
+
+private:
+    std::mutex Mutex;
+
+    FILE *PerfMap = nullptr;
+
+    FILE *JitDump = nullptr;
+    void *JitDumpMarker = nullptr;
+    uint64_t CodeIndex = 0;
+
+    void OpenJitDump();
+
+    void CloseJitDump();
+};
+
+#endif
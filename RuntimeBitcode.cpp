@@ -0,0 +1,61 @@
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/TargetParser/Host.h"
+#include "RuntimeBitcode.h"
+
+namespace {
+
+#ifdef SOLID_RUNTIME_BITCODE
+const unsigned char Bitcode[] = {
+#include "RuntimeBitcode.inc"
+};
+#endif
+
+}
+
+StringRef GetRuntimeBitcode() {
+#ifdef SOLID_RUNTIME_BITCODE
+    return {reinterpret_cast<const char *>(Bitcode), sizeof(Bitcode)};
+#else
+    return {};
+#endif
+}
+
+bool HasRuntimeBitcode() {
+    return !GetRuntimeBitcode().empty();
+}
+
+Error LinkRuntime(Module &Module) {
+    if (!HasRuntimeBitcode())
+        return Error::success();
+
+    // function bodies are only read if they are linked
+    auto Runtime = getLazyBitcodeModule(MemoryBufferRef(GetRuntimeBitcode(), "runtime.bc"), Module.getContext());
+    if (!Runtime)
+        return Runtime.takeError();
+
+    // JIT'd modules have no triple, they run on the host
+    Triple ModuleTriple(Module.getTargetTriple().empty() ? sys::getProcessTriple() : Module.getTargetTriple());
+    if (Triple((*Runtime)->getTargetTriple()).getArch() != ModuleTriple.getArch())
+        return Error::success();
+
+    (*Runtime)->setTargetTriple(Module.getTargetTriple());
+    (*Runtime)->setDataLayout(Module.getDataLayout());
+
+    for (auto &Function: **Runtime) {
+        if (Function.isDeclaration() || !Function.hasExternalLinkage())
+            continue;
+
+        Function.setLinkage(GlobalValue::AvailableExternallyLinkage);
+
+        // compiled for the module's target instead of the one the runtime has been built for
+        Function.removeFnAttr("target-cpu");
+        Function.removeFnAttr("target-features");
+        Function.removeFnAttr("tune-cpu");
+    }
+
+    if (Linker::linkModules(Module, std::move(*Runtime), Linker::Flags::LinkOnlyNeeded))
+        return make_error<StringError>("could not link the runtime", inconvertibleErrorCode());
+    return Error::success();
+}
@@ -0,0 +1,22 @@
+#ifndef SOLID_LANG_RUNTIMEBITCODE_H
+#define SOLID_LANG_RUNTIMEBITCODE_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+
+using namespace llvm;
+
+// The built-ins are also compiled to bitcode (if clang was found when building), which is embedded in the compiler.
+// Linking it into a module lets the optimizer inline and specialize calls to them. The runtime's functions are linked
+// as available_externally, so calls that aren't inlined still go to the compiled runtime.
+
+// Whether the runtime bitcode has been embedded
+bool HasRuntimeBitcode();
+
+// The embedded bitcode, empty without it
+StringRef GetRuntimeBitcode();
+
+// Links the runtime functions Module calls into it, does nothing without runtime bitcode or for another architecture
+Error LinkRuntime(Module &Module);
+
+#endif
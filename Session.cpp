@@ -0,0 +1,256 @@
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/TargetSelect.h"
+#include "IRGenerator.h"
+#include "Session.h"
+
+Expected<std::unique_ptr<Session>> Session::Create(const JITOptions &Options) {
+    static std::once_flag InitializeTarget;
+    std::call_once(InitializeTarget, []() {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser();
+    });
+
+    auto JIT = JIT::Create(Options);
+    if (!JIT)
+        return JIT.takeError();
+
+    return std::make_unique<Session>(std::move(*JIT));
+}
+
+Session::Session(std::unique_ptr<class JIT> JIT)
+        : JIT(std::move(JIT)),
+          Lexer(std::make_unique<class Lexer>(std::string())),
+          Parser(std::make_unique<class Parser>(*Lexer, [this](const std::string &Message) {
+              Errors.push_back(Message);
+          })) {}
+
+Error Session::Compile(StringRef Source) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    Errors.clear();
+    Lexer->SetSource(Source.str());
+    Lexer->GetNextToken();
+
+    std::vector<ThreadSafeModule> Modules;
+    std::vector<std::string> Redefined;
+    while (Lexer->GetCurrentToken() != t_eof) {
+        switch (Lexer->GetCurrentToken()) {
+            case ';':
+                Lexer->GetNextToken();
+                break;
+            case t_func:
+            case t_operator: {
+                auto Definition = Parser->ParseFunctionDefinition();
+                if (!Definition) {
+                    Lexer->GetNextToken();
+                    break;
+                }
+                std::string Name = Definition->GetName();
+                if (auto TSM = Generate(*Definition)) {
+                    Modules.push_back(std::move(TSM));
+                    Redefined.push_back(Name);
+                    Definitions[Name] = std::move(Definition);
+                }
+                break;
+            }
+            case t_native: {
+                auto Declaration = Parser->ParseNative();
+                if (!Declaration) {
+                    Lexer->GetNextToken();
+                    break;
+                }
+                FunctionDeclarations[Declaration->GetName()] = std::move(Declaration);
+                break;
+            }
+            default: {
+                Errors.push_back("top level expressions can't be compiled into a session, use Evaluate");
+                if (!Parser->ParseTopLevelExpression())
+                    Lexer->GetNextToken();
+                break;
+            }
+        }
+    }
+
+    if (!Modules.empty()) {
+        if (auto Err = JIT->AddFunctions(std::move(Modules)))
+            return Err;
+    }
+
+    for (auto &Name: Redefined) {
+        if (auto Err = RemoveSpecializations(Name))
+            return Err;
+    }
+
+    return TakeErrors();
+}
+
+Expected<double> Session::Evaluate(StringRef Expression) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    Errors.clear();
+    Lexer->SetSource(Expression.str());
+    Lexer->GetNextToken();
+
+    auto Definition = Parser->ParseTopLevelExpression();
+    while (Definition && Lexer->GetCurrentToken() == ';')
+        Lexer->GetNextToken();
+    if (Definition && Lexer->GetCurrentToken() != t_eof)
+        Errors.push_back("expected a single expression");
+
+    ThreadSafeModule TSM;
+    if (Definition && Errors.empty())
+        TSM = Generate(*Definition);
+    if (!TSM) {
+        if (auto Err = TakeErrors())
+            return std::move(Err);
+        return make_error<StringError>("expression did not compile", inconvertibleErrorCode());
+    }
+
+    auto Tracker = JIT->GetMain().createResourceTracker();
+    if (auto Err = JIT->AddModule(std::move(TSM), Tracker))
+        return std::move(Err);
+
+    auto Symbol = JIT->Lookup("__anonymous_top_level_expr");
+    if (!Symbol) {
+        consumeError(Tracker->remove());
+        return Symbol.takeError();
+    }
+
+    double Result = jitTargetAddressToFunction<double (*)()>(Symbol->getAddress())();
+
+    if (auto Err = Tracker->remove())
+        return std::move(Err);
+    return Result;
+}
+
+ThreadSafeModule Session::Generate(FunctionDefinition &Definition) {
+    auto Context = std::make_unique<LLVMContext>();
+    auto Module = std::make_unique<class Module>("Solid session", *Context);
+    Module->setDataLayout(JIT->GetDataLayout());
+
+    IRBuilder<> Builder(*Context);
+    IRGenerator Generator(*Context, Builder, *Module, nullptr, ValuesByName, FunctionDeclarations,
+                          [this](const std::string &Message) { Errors.push_back(Message); });
+
+    Definition.Accept(Generator);
+    if (!Generator.GetValue())
+        return ThreadSafeModule();
+
+    return ThreadSafeModule(std::move(Module), std::move(Context));
+}
+
+Error Session::TakeErrors() {
+    if (Errors.empty())
+        return Error::success();
+
+    std::string Message;
+    for (auto &Entry: Errors) {
+        if (!Message.empty())
+            Message += "\n";
+        Message += Entry;
+    }
+    Errors.clear();
+
+    return make_error<StringError>(Message, inconvertibleErrorCode());
+}
+
+Expected<JITTargetAddress> Session::GetFunctionAddress(StringRef Name, unsigned Arity) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    auto Declaration = FunctionDeclarations.find(Name.str());
+    if (Declaration == FunctionDeclarations.end())
+        return make_error<StringError>("unknown function " + Name, inconvertibleErrorCode());
+
+    auto ArgumentCount = Declaration->second->GetArguments().size();
+    if (ArgumentCount != Arity) {
+        return make_error<StringError>(Name + " takes " + std::to_string(ArgumentCount) + " arguments",
+                                       inconvertibleErrorCode());
+    }
+
+    auto Symbol = JIT->Lookup(Name);
+    if (!Symbol)
+        return Symbol.takeError();
+    return Symbol->getAddress();
+}
+
+Expected<JITTargetAddress> Session::GetSpecializationAddress(StringRef Name, const std::map<unsigned, double> &Constants,
+                                                             unsigned Arity) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    auto Definition = Definitions.find(Name.str());
+    if (Definition == Definitions.end())
+        return make_error<StringError>("unknown function " + Name, inconvertibleErrorCode());
+
+    auto Arguments = FunctionDeclarations[Name.str()]->GetArguments();
+    for (auto &Constant: Constants) {
+        if (Constant.first >= Arguments.size()) {
+            return make_error<StringError>(Name + " has no argument " + std::to_string(Constant.first),
+                                           inconvertibleErrorCode());
+        }
+    }
+    if (Arguments.size() - Constants.size() != Arity) {
+        return make_error<StringError>(Name + " takes " + std::to_string(Arguments.size() - Constants.size()) +
+                                       " arguments once specialized", inconvertibleErrorCode());
+    }
+
+    // constants by their bits, so -0 and NaNs get versions of their own
+    std::string Key = Name.str() + "(";
+    for (unsigned i = 0; i < Arguments.size(); ++i) {
+        if (i > 0)
+            Key += ",";
+        auto Constant = Constants.find(i);
+        Key += Constant == Constants.end() ? "_" : "0x" + utohexstr(DoubleToBits(Constant->second));
+    }
+    Key += ")";
+
+    auto Cached = Specializations.find(Key);
+    if (Cached != Specializations.end())
+        return Cached->second.Address;
+
+    auto Context = std::make_unique<LLVMContext>();
+    auto Module = std::make_unique<class Module>("Solid specialization", *Context);
+    Module->setDataLayout(JIT->GetDataLayout());
+
+    std::string SpecializedName = Name.str() + "$spec" + std::to_string(SpecializationCount++);
+
+    IRBuilder<> Builder(*Context);
+    IRGenerator Generator(*Context, Builder, *Module, nullptr, ValuesByName, FunctionDeclarations,
+                          [this](const std::string &Message) { Errors.push_back(Message); });
+    if (!Generator.Specialize(SpecializedName, Arguments, Constants, Definition->second->GetImplementation())) {
+        if (auto Err = TakeErrors())
+            return std::move(Err);
+        return make_error<StringError>("specialization did not compile", inconvertibleErrorCode());
+    }
+
+    auto Tracker = JIT->GetMain().createResourceTracker();
+    if (auto Err = JIT->AddOptimizedModule(ThreadSafeModule(std::move(Module), std::move(Context)), Tracker))
+        return std::move(Err);
+
+    auto Symbol = JIT->Lookup(SpecializedName);
+    if (!Symbol) {
+        consumeError(Tracker->remove());
+        return Symbol.takeError();
+    }
+
+    Specializations[Key] = {Name.str(), Symbol->getAddress(), Tracker};
+    return Symbol->getAddress();
+}
+
+Error Session::RemoveSpecializations(const std::string &Name) {
+    for (auto Entry = Specializations.begin(); Entry != Specializations.end();) {
+        if (Entry->second.Function != Name) {
+            ++Entry;
+            continue;
+        }
+
+        if (auto Err = Entry->second.Tracker->remove())
+            return Err;
+        Entry = Specializations.erase(Entry);
+    }
+    return Error::success();
+}
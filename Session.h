@@ -0,0 +1,105 @@
+#ifndef SOLID_LANG_SESSION_H
+#define SOLID_LANG_SESSION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Expression.h"
+#include "JIT.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Embeds the compiler into a host program: source is compiled from strings into a JIT and its functions are handed
+// out as native function pointers. Compiling is serialized, the returned functions can be called from any thread.
+// Redefining a function frees the code of the old definition, so it must not be redefined while it's running.
+class Session {
+
+public:
+    static Expected<std::unique_ptr<Session>> Create(const JITOptions &Options = JITOptions());
+
+    explicit Session(std::unique_ptr<class JIT> JIT);
+
+    // Compiles the functions, operators and natives defined in Source. Functions that compile are defined
+    // even if others fail, the error lists all messages.
+    Error Compile(StringRef Source);
+
+    // Compiles and runs a single expression, e.g. `fib(10) + 1`
+    Expected<double> Evaluate(StringRef Expression);
+
+    // Pointer to the function Name, which has to take as many arguments as the pointer type,
+    // e.g. `GetFunction<double, double>("avg")` returns a `double (*)(double, double)`
+    template<typename... Arguments>
+    Expected<double (*)(Arguments...)> GetFunction(StringRef Name) {
+        static_assert((std::is_same_v<Arguments, double> && ...), "Solid functions only take doubles");
+
+        auto Address = GetFunctionAddress(Name, sizeof...(Arguments));
+        if (!Address)
+            return Address.takeError();
+        return jitTargetAddressToFunction<double (*)(Arguments...)>(*Address);
+    }
+
+    // Compiles a version of Name with some of its arguments (by index) bound to constants, optimized at O3 so
+    // branches and loops on them fold away. Versions are cached per function and constants. The result takes the
+    // remaining arguments, e.g. `Specialize<double>("scale", {{0, 2.5}})` for `func scale(factor x)`.
+    template<typename... Arguments>
+    Expected<double (*)(Arguments...)> Specialize(StringRef Name, const std::map<unsigned, double> &Constants) {
+        static_assert((std::is_same_v<Arguments, double> && ...), "Solid functions only take doubles");
+
+        auto Address = GetSpecializationAddress(Name, Constants, sizeof...(Arguments));
+        if (!Address)
+            return Address.takeError();
+        return jitTargetAddressToFunction<double (*)(Arguments...)>(*Address);
+    }
+
+    class JIT &GetJIT() { return *JIT; }
+
+private:
+    std::unique_ptr<class JIT> JIT;
+
+    std::mutex Mutex;
+
+    std::unique_ptr<Lexer> Lexer;
+    std::unique_ptr<Parser> Parser;
+
+    std::map<std::string, AllocaInst *> ValuesByName;
+    std::map<std::string, std::unique_ptr<FunctionDeclaration>> FunctionDeclarations;
+
+    // bodies of the compiled functions, for specializing them
+    std::map<std::string, std::unique_ptr<FunctionDefinition>> Definitions;
+
+    struct Specialization {
+        std::string Function;
+        JITTargetAddress Address;
+        ResourceTrackerSP Tracker;
+    };
+
+    // by function and constants, e.g. `scale(0x4004000000000000,_)`
+    std::map<std::string, Specialization> Specializations;
+    unsigned SpecializationCount = 0;
+
+    // messages of the current Compile or Evaluate call
+    std::vector<std::string> Errors;
+
+    // generates a module with just this function (nothing if it doesn't compile)
+    ThreadSafeModule Generate(FunctionDefinition &Definition);
+
+    Error TakeErrors();
+
+    Expected<JITTargetAddress> GetFunctionAddress(StringRef Name, unsigned Arity);
+
+    Expected<JITTargetAddress> GetSpecializationAddress(StringRef Name, const std::map<unsigned, double> &Constants,
+                                                        unsigned Arity);
+
+    // removes the specializations of a function that has been redefined
+    Error RemoveSpecializations(const std::string &Name);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "llvm/ExecutionEngine/JITLink/JITLink.h"
+#include "llvm/Support/Process.h"
+#include <cstring>
+#include "SlabMemoryManager.h"
+
+static const sys::Memory::ProtectionFlags ReadWrite =
+        static_cast<sys::Memory::ProtectionFlags>(sys::Memory::MF_READ | sys::Memory::MF_WRITE);
+
+class SlabMemoryManager::SlabInFlightAlloc : public JITLinkMemoryManager::InFlightAlloc {
+
+public:
+    SlabInFlightAlloc(SlabMemoryManager &MemoryManager, LinkGraph &G, BasicLayout Layout,
+                      sys::MemoryBlock StandardSegments, sys::MemoryBlock FinalizeSegments, SectionSizes Sizes)
+            : MemoryManager(MemoryManager), G(G), Layout(std::move(Layout)), StandardSegments(StandardSegments),
+              FinalizeSegments(FinalizeSegments), Sizes(Sizes) {}
+
+    void finalize(OnFinalizedFunction OnFinalized) override {
+        if (auto Err = ApplyProtections()) {
+            OnFinalized(std::move(Err));
+            return;
+        }
+
+        auto DeallocActions = orc::shared::runFinalizeActions(Layout.graphAllocActions());
+        if (!DeallocActions) {
+            OnFinalized(DeallocActions.takeError());
+            return;
+        }
+
+        // finalize segments (e.g. relocation-only data) are not needed once the object is linked
+        MemoryManager.Release(FinalizeSegments);
+
+        auto *Info = new FinalizedAllocInfo{StandardSegments, std::move(*DeallocActions), Sizes};
+        OnFinalized(FinalizedAlloc(orc::ExecutorAddr::fromPtr(Info)));
+    }
+
+    void abandon(OnAbandonedFunction OnAbandoned) override {
+        MemoryManager.Release(FinalizeSegments);
+        MemoryManager.Release(StandardSegments, &Sizes);
+        OnAbandoned(Error::success());
+    }
+
+private:
+    SlabMemoryManager &MemoryManager;
+    LinkGraph &G;
+    BasicLayout Layout;
+    sys::MemoryBlock StandardSegments;
+    sys::MemoryBlock FinalizeSegments;
+    SectionSizes Sizes;
+
+    Error ApplyProtections() {
+        for (auto &Entry: Layout.segments()) {
+            auto &Group = Entry.first;
+            auto &Segment = Entry.second;
+
+            auto Protection = toSysMemoryProtectionFlags(Group.getMemProt());
+            uint64_t Size = alignTo(Segment.ContentSize + Segment.ZeroFillSize, MemoryManager.PageSize);
+            sys::MemoryBlock Block(Segment.WorkingMem, Size);
+
+            if (auto ErrorCode = sys::Memory::protectMappedMemory(Block, Protection))
+                return errorCodeToError(ErrorCode);
+            if (Protection & sys::Memory::MF_EXEC)
+                sys::Memory::InvalidateInstructionCache(Block.base(), Block.allocatedSize());
+        }
+        return Error::success();
+    }
+};
+
+Expected<std::unique_ptr<SlabMemoryManager>> SlabMemoryManager::Create(uint64_t SlabSize) {
+    auto PageSize = sys::Process::getPageSize();
+    if (!PageSize)
+        return PageSize.takeError();
+
+    return std::make_unique<SlabMemoryManager>(*PageSize, alignTo(SlabSize, *PageSize));
+}
+
+SlabMemoryManager::~SlabMemoryManager() {
+    for (auto &Slab: Slabs)
+        sys::Memory::releaseMappedMemory(Slab);
+}
+
+void SlabMemoryManager::allocate(const JITLinkDylib *JD, LinkGraph &G, OnAllocatedFunction OnAllocated) {
+    BasicLayout Layout(G);
+
+    auto Sizes = Layout.getContiguousPageBasedLayoutSizes(PageSize);
+    if (!Sizes) {
+        OnAllocated(Sizes.takeError());
+        return;
+    }
+
+    // allocate everything in one range to keep the object's segments within reach of each other
+    auto Block = Allocate(Sizes->total());
+    if (!Block) {
+        OnAllocated(Block.takeError());
+        return;
+    }
+
+    auto *Base = static_cast<char *>(Block->base());
+    sys::MemoryBlock StandardSegments(Base, Sizes->StandardSegs);
+    sys::MemoryBlock FinalizeSegments(Base + Sizes->StandardSegs, Sizes->FinalizeSegs);
+
+    auto NextStandardAddress = orc::ExecutorAddr::fromPtr(StandardSegments.base());
+    auto NextFinalizeAddress = orc::ExecutorAddr::fromPtr(FinalizeSegments.base());
+    SectionSizes SegmentSizes;
+
+    for (auto &Entry: Layout.segments()) {
+        auto &Group = Entry.first;
+        auto &Segment = Entry.second;
+
+        if (Group.getMemDeallocPolicy() == MemDeallocPolicy::Standard) {
+            auto &Bytes = (Group.getMemProt() & MemProt::Exec) != MemProt::None ? SegmentSizes.CodeBytes
+                                                                                 : SegmentSizes.DataBytes;
+            Bytes += Segment.ContentSize + Segment.ZeroFillSize;
+        }
+
+        auto &Address = Group.getMemDeallocPolicy() == MemDeallocPolicy::Standard
+                        ? NextStandardAddress
+                        : NextFinalizeAddress;
+
+        Segment.WorkingMem = Address.toPtr<char *>();
+        Segment.Addr = Address;
+        Address += alignTo(Segment.ContentSize + Segment.ZeroFillSize, PageSize);
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Stats.CodeBytes += SegmentSizes.CodeBytes;
+        Stats.DataBytes += SegmentSizes.DataBytes;
+    }
+
+    if (auto Err = Layout.apply()) {
+        Release(*Block, &SegmentSizes);
+        OnAllocated(std::move(Err));
+        return;
+    }
+
+    OnAllocated(std::make_unique<SlabInFlightAlloc>(*this, G, std::move(Layout), StandardSegments,
+                                                    FinalizeSegments, SegmentSizes));
+}
+
+void SlabMemoryManager::deallocate(std::vector<FinalizedAlloc> Allocs, OnDeallocatedFunction OnDeallocated) {
+    Error DeallocErr = Error::success();
+
+    for (auto &Alloc: Allocs) {
+        auto *Info = Alloc.release().toPtr<FinalizedAllocInfo *>();
+
+        while (!Info->DeallocActions.empty()) {
+            if (auto Err = Info->DeallocActions.back().runWithSPSRetErrorMerged())
+                DeallocErr = joinErrors(std::move(DeallocErr), std::move(Err));
+            Info->DeallocActions.pop_back();
+        }
+
+        Release(Info->StandardSegments, &Info->Sizes);
+        delete Info;
+    }
+
+    OnDeallocated(std::move(DeallocErr));
+}
+
+CodeMemoryStats SlabMemoryManager::GetStats() {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    return Stats;
+}
+
+Expected<sys::MemoryBlock> SlabMemoryManager::Allocate(uint64_t Size) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    auto Free = FreeRanges.begin();
+    while (Free != FreeRanges.end() && Free->second < Size)
+        ++Free;
+
+    if (Free == FreeRanges.end()) {
+        std::error_code ErrorCode;
+        auto Slab = sys::Memory::allocateMappedMemory(std::max(Size, SlabSize), nullptr, ReadWrite, ErrorCode);
+        if (ErrorCode)
+            return errorCodeToError(ErrorCode);
+
+        Slabs.push_back(Slab);
+        Stats.Mappings++;
+        Stats.MappedBytes += Slab.allocatedSize();
+
+        Free = FreeRanges.emplace(static_cast<char *>(Slab.base()), Slab.allocatedSize()).first;
+    }
+
+    char *Start = Free->first;
+    uint64_t Remaining = Free->second - Size;
+    FreeRanges.erase(Free);
+    if (Remaining > 0)
+        FreeRanges.emplace(Start + Size, Remaining);
+
+    // zero-fill sections rely on the memory being cleared
+    memset(Start, 0, Size);
+
+    Stats.UsedBytes += Size;
+    Stats.Allocations++;
+    return sys::MemoryBlock(Start, Size);
+}
+
+void SlabMemoryManager::Release(sys::MemoryBlock Block, const SectionSizes *Sizes) {
+    if (Sizes) {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Stats.Allocations--;
+        Stats.CodeBytes -= Sizes->CodeBytes;
+        Stats.DataBytes -= Sizes->DataBytes;
+    }
+
+    if (Block.allocatedSize() == 0)
+        return;
+
+    // freed pages may have been made executable or read-only, make them writable for reuse
+    sys::Memory::protectMappedMemory(Block, ReadWrite);
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    char *Start = static_cast<char *>(Block.base());
+    uint64_t Size = Block.allocatedSize();
+    Stats.UsedBytes -= Size;
+
+    // merge with the neighboring free ranges
+    auto Next = FreeRanges.lower_bound(Start);
+    if (Next != FreeRanges.end() && Start + Size == Next->first) {
+        Size += Next->second;
+        Next = FreeRanges.erase(Next);
+    }
+    if (Next != FreeRanges.begin()) {
+        auto Previous = std::prev(Next);
+        if (Previous->first + Previous->second == Start) {
+            Start = Previous->first;
+            Size += Previous->second;
+            FreeRanges.erase(Previous);
+        }
+    }
+
+    FreeRanges.emplace(Start, Size);
+}
@@ -0,0 +1,83 @@
+#ifndef SOLID_LANG_SLABMEMORYMANAGER_H
+#define SOLID_LANG_SLABMEMORYMANAGER_H
+
+#include "llvm/ExecutionEngine/JITLink/JITLinkMemoryManager.h"
+#include "llvm/Support/Memory.h"
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+using namespace llvm::jitlink;
+using namespace llvm::orc;
+
+struct CodeMemoryStats {
+    // Number of memory mappings (slabs) requested from the OS
+    uint64_t Mappings = 0;
+
+    // Bytes mapped in total
+    uint64_t MappedBytes = 0;
+
+    // Bytes currently allocated to linked code and data
+    uint64_t UsedBytes = 0;
+
+    // Bytes of the live code and data sections
+    uint64_t CodeBytes = 0;
+    uint64_t DataBytes = 0;
+
+    // Number of live allocations (one per linked object)
+    uint64_t Allocations = 0;
+};
+
+// JITLink memory manager that carves allocations out of large slabs instead of mapping memory per object.
+// Allocations are placed first-fit by address, so code linked one after another ends up next to each other and
+// freed ranges are reused. Protections are applied per page, so code and data of different objects can share a slab.
+class SlabMemoryManager : public JITLinkMemoryManager {
+
+public:
+    class SlabInFlightAlloc;
+
+    static Expected<std::unique_ptr<SlabMemoryManager>> Create(uint64_t SlabSize);
+
+    SlabMemoryManager(uint64_t PageSize, uint64_t SlabSize) : PageSize(PageSize), SlabSize(SlabSize) {}
+
+    ~SlabMemoryManager() override;
+
+    void allocate(const JITLinkDylib *JD, LinkGraph &G, OnAllocatedFunction OnAllocated) override;
+
+    using JITLinkMemoryManager::allocate;
+
+    void deallocate(std::vector<FinalizedAlloc> Allocs, OnDeallocatedFunction OnDeallocated) override;
+
+    using JITLinkMemoryManager::deallocate;
+
+    CodeMemoryStats GetStats();
+
+private:
+    struct SectionSizes {
+        uint64_t CodeBytes = 0;
+        uint64_t DataBytes = 0;
+    };
+
+    struct FinalizedAllocInfo {
+        sys::MemoryBlock StandardSegments;
+        std::vector<orc::shared::WrapperFunctionCall> DeallocActions;
+        SectionSizes Sizes;
+    };
+
+    uint64_t PageSize;
+    uint64_t SlabSize;
+
+    std::mutex Mutex;
+    std::vector<sys::MemoryBlock> Slabs;
+    // free page ranges by start address
+    std::map<char *, uint64_t> FreeRanges;
+    CodeMemoryStats Stats;
+
+    Expected<sys::MemoryBlock> Allocate(uint64_t Size);
+
+    // Sizes: of the allocation's sections, when this is the last part of it to be released
+    void Release(sys::MemoryBlock Block, const SectionSizes *Sizes = nullptr);
+};
+
+#endif
@@ -3,40 +3,106 @@
 int SolidLang::Start() {
     int ExitCode = 0;
 
-    InitializeNativeTarget();
-    InitializeNativeTargetAsmPrinter();
-    InitializeNativeTargetAsmParser();
+    // several instances may start on different threads
+    static std::once_flag TargetsInitialized;
+    if (!UsesVM()) {
+        std::call_once(TargetsInitialized, []() {
+            InitializeNativeTarget();
+            InitializeNativeTargetAsmPrinter();
+            InitializeNativeTargetAsmParser();
+        });
+    }
 
     if (IsRepl()) {
         In = stdin;
     } else {
         In = fopen(InputFile.c_str(), "r");
+        if (!In) {
+            fprintf(stderr, "Error: could not open %s\n", InputFile.c_str());
+            return 1;
+        }
+    }
+
+    FILE *PreludeIn = nullptr;
+    if (!Prelude.empty()) {
+        PreludeIn = fopen(Prelude.c_str(), "r");
+        if (!PreludeIn) {
+            fprintf(stderr, "Error: could not open %s\n", Prelude.c_str());
+            return 1;
+        }
+    }
+
+    Lexer = std::make_unique<class Lexer>(PreludeIn ? PreludeIn : In);
+    Parser = std::make_unique<class Parser>(*Lexer, OnError);
+
+    if (UsesVM()) {
+        InitVM();
+    } else {
+        // object files only need the target
+        if (RunsInput()) {
+            JIT = OnErrorExit(JIT::Create(Options));
+        } else {
+            Machine = OnErrorExit(CreateTargetMachine());
+        }
+        InitLLVM();
+
+        // the generated IR of top level expressions is only printed when they are compiled
+        if (RunsInput() && Interpret && !PrintIR) {
+            Interpreter = std::make_unique<class Interpreter>(*JIT, FunctionDeclarations);
+        }
     }
 
-    Lexer = std::make_unique<class Lexer>(In);
-    Parser = std::make_unique<class Parser>(*Lexer);
+    if (PreludeIn) {
+        ReadingPrelude = true;
+        Lexer->GetNextToken();
+        ProcessInput();
+        ReadingPrelude = false;
+        fclose(PreludeIn);
+
+        // every object file defines the prelude's operators, the linker keeps one of them
+        if (!RunsInput() && !UsesVM()) {
+            for (auto &Function: *Module) {
+                if (!Function.isDeclaration())
+                    Function.setLinkage(GlobalValue::LinkOnceODRLinkage);
+            }
+        }
+
+        Lexer->SetInput(In);
+    }
 
     IfReplPrint("ready> ");
     Lexer->GetNextToken();
 
-    JIT = OnErrorExit(JIT::Create());
-    InitLLVM();
-
     ProcessInput();
 
     if (!IsRepl()) {
         fclose(In);
     }
 
-    if (HasOutputFile()) {
-        ExitCode = WriteObjectFile();
+    // the VM runs input files instead of compiling them, the JIT does so with --run
+    if (HasOutputFile() && !UsesVM() && !Run) {
+        if (Errors && !IsRepl()) {
+            fprintf(stderr, "%s: %u errors, no object file written\n", InputFile.c_str(), Errors);
+            ExitCode = 1;
+        } else {
+            ExitCode = WriteObjectFile();
+        }
     }
 
-    if (PrintIR) {
+    // what did compile has run, but batch jobs need to see that the rest didn't
+    if (Run && Errors) {
+        ExitCode = 1;
+    }
+
+    if (PrintIR && Module) {
         errs() << "\n";
         Module->print(errs(), nullptr);
     }
 
+    if (PrintMemoryStats) {
+        PrintCodeMemoryStats();
+    }
+
     return ExitCode;
 }
 
@@ -56,13 +122,17 @@ void SolidLang::ProcessInput() {
                 HandleFunction(Result.get());
                 break;
             }
+            case t_command:
+                HandleCommand();
+                IfReplPrint("ready> ");
+                break;
             case t_native: {
                 std::unique_ptr<FunctionDeclaration> Result = Parser->ParseNative();
                 HandleNative(std::move(Result));
                 break;
             }
             default: {
-                std::unique_ptr<Expression> Result = Parser->ParseTopLevelExpression();
+                std::unique_ptr<FunctionDefinition> Result = Parser->ParseTopLevelExpression();
                 HandleTopLevelExpression(Result.get());
                 IfReplPrint("ready> ");
                 break;
@@ -74,10 +144,15 @@ void SolidLang::ProcessInput() {
 void SolidLang::InitLLVM() {
     Context = std::make_unique<LLVMContext>();
     Module = std::make_unique<class Module>("Solid JIT", *Context);
-    Module->setDataLayout(JIT->GetDataLayout());
+    if (JIT) {
+        Module->setDataLayout(JIT->GetDataLayout());
+    } else if (Machine) {
+        Module->setTargetTriple(Machine->getTargetTriple().str());
+        Module->setDataLayout(Machine->createDataLayout());
+    }
 
     std::unique_ptr<legacy::FunctionPassManager> PassManager = nullptr;
-    if (!IsRepl()) {
+    if (!RunsInput() && Level != OptimizationLevel::O0) {
         PassManager = std::make_unique<legacy::FunctionPassManager>(Module.get());
         PassManager->add(createPromoteMemoryToRegisterPass());
         PassManager->add(createInstructionCombiningPass());
@@ -90,7 +165,7 @@ void SolidLang::InitLLVM() {
     Builder = std::make_unique<IRBuilder<>>(*Context);
 
     auto IRGenerator = std::make_unique<class IRGenerator>(*Context, *Builder, *Module, std::move(PassManager),
-                                                           ValuesByName, FunctionDeclarations);
+                                                           ValuesByName, FunctionDeclarations, OnError);
 
     if (PrintIR) {
         Visitor = std::make_unique<class IRPrinter>(std::move(IRGenerator));
@@ -99,54 +174,122 @@ void SolidLang::InitLLVM() {
     }
 }
 
-int SolidLang::WriteObjectFile() {
+void SolidLang::InitVM() {
+    VM = std::make_unique<class VM>();
+    Visitor = std::make_unique<BytecodeCompiler>(*VM, FunctionDeclarations);
+}
+
+Expected<std::unique_ptr<TargetMachine>> SolidLang::CreateTargetMachine() {
     auto TargetTriple = sys::getDefaultTargetTriple();
-    Module->setTargetTriple(TargetTriple);
 
     std::string Error;
     auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
 
     if (!Target) {
-        errs() << Error;
-        return 1;
+        return make_error<StringError>(Error, inconvertibleErrorCode());
     }
 
     auto CPU = "generic";
     TargetOptions Options;
-    auto Machine = Target->createTargetMachine(TargetTriple, CPU, "", Options, std::optional<Reloc::Model>());
+    // position independent, for shared libraries and executables alike
+    return std::unique_ptr<TargetMachine>(
+            Target->createTargetMachine(TargetTriple, CPU, "", Options, Reloc::PIC_));
+}
+
+int SolidLang::WriteObjectFile() {
+    // the REPL compiles with the JIT's target until now
+    if (!Machine) {
+        Machine = OnErrorExit(CreateTargetMachine());
+    }
 
+    Module->setTargetTriple(Machine->getTargetTriple().str());
     Module->setDataLayout(Machine->createDataLayout());
 
-    std::error_code ErrorCode;
-    raw_fd_ostream OutputStream(OutputFile, ErrorCode, sys::fs::OF_None);
+    // libraries are packaged from an object file of their own
+    std::string ObjectFile = OutputFile;
+    if (Emit != Emit::Object) {
+        SmallString<128> Path;
+        if (auto ErrorCode = sys::fs::createTemporaryFile("solid", "o", Path)) {
+            errs() << "could not create a temporary file: " << ErrorCode.message() << "\n";
+            return 1;
+        }
+        ObjectFile = Path.str().str();
+    }
 
-    if (ErrorCode) {
-        errs() << "could not open file: " << ErrorCode.message();
+    IncrementalStats Stats;
+    auto Write = [&]() -> Error {
+        if (auto Err = WriteObject(ObjectFile, Stats))
+            return Err;
+
+        FindExportedFunctions();
+        if (Emit != Emit::Object) {
+            if (auto Err = WriteLibrary(Emit, {ObjectFile}, {sys::path::stem(InputFile).str() + ".o"},
+                                        ExportedFunctions, OutputFile, RuntimeDirectory, Options.VectorLibrary))
+                return Err;
+        }
+
+        // objects linked with others get the header of the linked file
+        return Quiet ? Error::success() : WriteHeader(ExportedFunctions, OutputFile);
+    };
+
+    Error Result = Write();
+    if (ObjectFile != OutputFile) {
+        sys::fs::remove(ObjectFile);
+    }
+    if (Result) {
+        errs() << toString(std::move(Result)) << "\n";
         return 1;
     }
 
-    legacy::PassManager OutputPassManager;
-    if (Machine->addPassesToEmitFile(OutputPassManager, OutputStream, nullptr, CGFT_ObjectFile)) {
-        errs() << "could not emit file";
-        return 1;
+    if (!Quiet && Options.CacheDirectory.empty()) {
+        fprintf(stdout, "created %s\n", OutputFile.c_str());
+    } else if (!Quiet) {
+        fprintf(stdout, "created %s (%u of %u functions reused)\n", OutputFile.c_str(), Stats.Reused, Stats.Functions);
+    }
+
+    return 0;
+}
+
+Error SolidLang::WriteObject(StringRef ObjectFile, IncrementalStats &Stats) {
+    // with a cache directory, functions that didn't change since the last build are reused
+    if (!Options.CacheDirectory.empty()) {
+        CompileCache Cache(Options.CacheDirectory, Options.CacheSizeLimit);
+        return CompileObjectIncrementally(*Module, *Machine, Cache, ObjectFile, Stats, Level,
+                                          Options.VectorLibrary);
     }
 
-    OutputPassManager.run(*Module);
-    OutputStream.flush();
+    std::error_code ErrorCode;
+    raw_fd_ostream OutputStream(ObjectFile, ErrorCode, sys::fs::OF_None);
 
-    outs() << "created " << OutputFile << "\n";
+    if (ErrorCode) {
+        return make_error<StringError>("could not open file: " + ErrorCode.message(), ErrorCode);
+    }
 
-    return 0;
+    return CompileObject(*Module, *Machine, OutputStream, Level, Options.VectorLibrary);
+}
+
+void SolidLang::FindExportedFunctions() {
+    ExportedFunctions.clear();
+
+    for (auto &[Name, Declaration]: FunctionDeclarations) {
+        // natives are defined elsewhere, operators have no names in C
+        auto *Function = Module->getFunction(Name);
+        if (!Function || Function->isDeclaration() || Declaration->IsNative() ||
+            !all_of(Name, [](char Character) { return isalnum((unsigned char) Character); })) {
+            continue;
+        }
+
+        ExportedFunctions.push_back({Name, Declaration->GetArguments()});
+    }
 }
 
 void SolidLang::HandleFunction(Expression *ParsedExpression) {
     if (ParsedExpression) {
         ParsedExpression->Accept(*Visitor);
 
-        if (IsRepl()) {
-            OnErrorExit(JIT->AddModule(
-                    ThreadSafeModule(std::move(Module), std::move(Context))
-            ));
+        // functions with errors have been removed again, declarations of the functions they call may be left
+        if (RunsInput() && !UsesVM() && DefinesFunction(*Module)) {
+            PendingModules.push_back(ThreadSafeModule(std::move(Module), std::move(Context)));
             InitLLVM();
         }
     } else {
@@ -163,11 +306,28 @@ void SolidLang::HandleNative(std::unique_ptr<FunctionDeclaration> Declaration) {
     }
 }
 
-void SolidLang::HandleTopLevelExpression(Expression *ParsedExpression) {
+void SolidLang::HandleTopLevelExpression(FunctionDefinition *ParsedExpression) {
     if (ParsedExpression) {
+        if (UsesVM()) {
+            ParsedExpression->Accept(*Visitor);
+            RunInVM();
+            return;
+        }
+
+        if (TryInterpret(ParsedExpression)) {
+            return;
+        }
+
         ParsedExpression->Accept(*Visitor);
 
-        if (IsRepl()) {
+        // errors have been reported already
+        if (RunsInput() && !DefinesFunction(*Module)) {
+            return;
+        }
+
+        if (RunsInput()) {
+            AddPendingModules();
+
             auto ResourceTracker = JIT->GetMain().createResourceTracker();
 
             OnErrorExit(JIT->AddModule(
@@ -176,16 +336,122 @@ void SolidLang::HandleTopLevelExpression(Expression *ParsedExpression) {
             ));
             InitLLVM();
 
-            auto TopLevelExprSymbol = OnErrorExit(JIT->Lookup("__anonymous_top_level_expr"));
-            assert(TopLevelExprSymbol && "Top level expression not found");
+            // e.g. calls of functions whose definitions had errors
+            auto TopLevelExprSymbol = JIT->Lookup("__anonymous_top_level_expr");
+            if (!TopLevelExprSymbol) {
+                OnError(toString(TopLevelExprSymbol.takeError()));
+                OnErrorExit(ResourceTracker->remove());
+                return;
+            }
 
             // Cast symbol's address to be able to call it as a native function (no arguments, returns double)
-            auto (*TopLevelExpr)() = (double (*)()) (intptr_t) TopLevelExprSymbol.getAddress();
-            fprintf(stderr, "Evaluated to %f\n", TopLevelExpr());
+            auto (*TopLevelExpr)() = (double (*)()) (intptr_t) TopLevelExprSymbol->getAddress();
+            double Result = TopLevelExpr();
+
+            // what the expression printed comes before its value
+            __solid_flush_output();
+            if (IsRepl()) {
+                fprintf(stderr, "Evaluated to %f\n", Result);
+            }
 
             OnErrorExit(ResourceTracker->remove());
+            OnErrorExit(JIT->EnforceMemoryBudget());
         }
     } else {
         Lexer->GetNextToken();
     }
 }
+
+bool SolidLang::TryInterpret(FunctionDefinition *ParsedExpression) {
+    if (!Interpreter) {
+        return false;
+    }
+
+    // called functions have to be compiled first
+    AddPendingModules();
+
+    auto Result = Interpreter->Evaluate(*ParsedExpression);
+    if (!Result) {
+        return false;
+    }
+
+    __solid_flush_output();
+    if (IsRepl()) {
+        fprintf(stderr, "Evaluated to %f\n", *Result);
+    }
+    OnErrorExit(JIT->EnforceMemoryBudget());
+    return true;
+}
+
+void SolidLang::RunInVM() {
+    // compile errors have been reported already
+    if (!VM->IsDefined("__anonymous_top_level_expr")) {
+        return;
+    }
+
+    auto Result = VM->Run("__anonymous_top_level_expr");
+    VM->Remove("__anonymous_top_level_expr");
+    __solid_flush_output();
+
+    if (!Result) {
+        fprintf(stderr, "Error: %s\n", toString(Result.takeError()).c_str());
+        return;
+    }
+
+    if (IsRepl()) {
+        fprintf(stderr, "Evaluated to %f\n", *Result);
+    }
+}
+
+void SolidLang::AddPendingModules() {
+    if (PendingModules.empty())
+        return;
+
+    if (auto Err = JIT->AddFunctions(std::move(PendingModules))) {
+        OnError(toString(std::move(Err)));
+    }
+    PendingModules.clear();
+}
+
+bool SolidLang::DefinesFunction(class Module &Module) {
+    return any_of(Module, [](Function &Function) { return !Function.isDeclaration() && !Function.hasLocalLinkage(); });
+}
+
+void SolidLang::HandleCommand() {
+    std::string Command = Lexer->GetIdVal();
+    Lexer->GetNextToken();
+
+    if (Command == "memory") {
+        PrintCodeMemoryStats();
+    } else {
+        fprintf(stderr, "Error: Unknown command \\%s\n", Command.c_str());
+    }
+}
+
+void SolidLang::PrintCodeMemoryStats() {
+    if (!JIT) {
+        fprintf(stderr, "Code memory statistics are only available with the JIT backend\n");
+        return;
+    }
+
+    // include functions that are defined but not compiled yet
+    AddPendingModules();
+
+    auto Stats = JIT->GetCodeMemoryStats();
+    fprintf(stderr, "Code memory: %llu bytes of code and %llu bytes of data in %llu objects\n",
+            (unsigned long long) Stats.CodeBytes, (unsigned long long) Stats.DataBytes,
+            (unsigned long long) Stats.Allocations);
+
+    if (Options.UseJITLink) {
+        fprintf(stderr, "Slabs: %llu mappings, %llu bytes mapped, %llu bytes used\n",
+                (unsigned long long) Stats.Mappings, (unsigned long long) Stats.MappedBytes,
+                (unsigned long long) Stats.UsedBytes);
+    }
+
+    if (Options.MemoryBudget) {
+        auto BudgetStats = JIT->GetMemoryBudgetStats();
+        fprintf(stderr, "Budget: %llu bytes, %llu evictions, %llu recompiles\n",
+                (unsigned long long) Options.MemoryBudget, (unsigned long long) BudgetStats.Evictions,
+                (unsigned long long) BudgetStats.Recompiles);
+    }
+}
@@ -10,6 +10,7 @@
 #include <llvm/Transforms/Utils.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
 #include "llvm/Support/CommandLine.h"
 #include <llvm/Target/TargetMachine.h>
@@ -18,29 +19,95 @@
 #include "Lexer.h"
 #include "Parser.h"
 #include "IRGenerator.h"
+#include "Interpreter.h"
 #include "JIT.h"
 #include "BuiltIns.h"
+#include "OutputRuntime.h"
+#include "DataRuntime.h"
+#include "BytecodeCompiler.h"
+#include "VM.h"
+#include "ObjectCompiler.h"
 
 using namespace llvm;
 using namespace llvm::orc;
 
+enum class Backend {
+    // compile to machine code with LLVM
+    JIT,
+    // compile to bytecode and run it on the VM
+    VM,
+};
+
 class SolidLang {
 
 public:
-    SolidLang(std::string InputFile, std::string OutputFile, bool PrintIR) : InputFile(std::move(InputFile)),
-                                                                             OutputFile(std::move(OutputFile)),
-                                                                             PrintIR(PrintIR) {}
+    SolidLang(std::string InputFile, std::string OutputFile, bool PrintIR, JITOptions Options,
+              bool PrintMemoryStats, bool Interpret, Backend Backend, bool Run = false, std::string Prelude = "")
+            : InputFile(std::move(InputFile)), OutputFile(std::move(OutputFile)), PrintIR(PrintIR),
+              Options(Options), PrintMemoryStats(PrintMemoryStats), Interpret(Interpret), Backend(Backend), Run(Run),
+              Prelude(std::move(Prelude)) {}
 
     int Start();
 
+    // doesn't report the object file it writes nor write its header, e.g. when it's linked with others
+    void SetQuiet() {
+        Quiet = true;
+    }
+
+    void SetEmit(enum Emit Emit) {
+        this->Emit = Emit;
+    }
+
+    // where shared libraries load the runtime library from (default: their own directory)
+    void SetRuntimeDirectory(const std::string &RuntimeDirectory) {
+        this->RuntimeDirectory = RuntimeDirectory;
+    }
+
+    // of object files: O0 compiles without optimizations, O1 runs the function passes, O2 and O3 LLVM's pipeline too
+    void SetOptimizationLevel(OptimizationLevel Level) {
+        this->Level = Level;
+    }
+
+    // functions of the object file that has been written, which C can call
+    const std::vector<ExportedFunction> &GetExportedFunctions() const {
+        return ExportedFunctions;
+    }
+
 private:
     FILE *In;
 
     std::string InputFile;
     std::string OutputFile;
     bool PrintIR;
+    JITOptions Options;
+    bool PrintMemoryStats;
+    bool Interpret;
+    enum Backend Backend;
+    bool Run;
+    // read before the input, usually natives and operators shared by many files
+    std::string Prelude;
+    bool ReadingPrelude = false;
+    bool Quiet = false;
+    enum Emit Emit = Emit::Object;
+    std::string RuntimeDirectory;
+    OptimizationLevel Level = OptimizationLevel::O2;
+    std::vector<ExportedFunction> ExportedFunctions;
+
+    // errors name the input file, object files aren't written if there were any
+    unsigned Errors = 0;
+    ErrorHandler OnError = [this](const std::string &Message) {
+        ++Errors;
+        if (IsRepl())
+            PrintError(Message);
+        else
+            fprintf(stderr, "%s: Error: %s\n", InputFile.c_str(), Message.c_str());
+    };
 
     std::unique_ptr<JIT> JIT;
+    // target of object files, which are compiled without a JIT
+    std::unique_ptr<TargetMachine> Machine;
+    std::unique_ptr<Interpreter> Interpreter;
+    std::unique_ptr<VM> VM;
     std::unique_ptr<LLVMContext> Context;
     std::unique_ptr<class Module> Module;
 
@@ -53,30 +120,64 @@ private:
     std::map<std::string, AllocaInst *> ValuesByName;
     std::map<std::string, std::unique_ptr<FunctionDeclaration>> FunctionDeclarations;
 
+    // functions defined since the last top level expression, compiled together before it runs (or replace
+    // their previous definitions)
+    std::vector<ThreadSafeModule> PendingModules;
+
     ExitOnError OnErrorExit;
 
     void ProcessInput();
 
     void InitLLVM();
 
+    void InitVM();
+
+    static Expected<std::unique_ptr<TargetMachine>> CreateTargetMachine();
+
     int WriteObjectFile();
 
+    Error WriteObject(StringRef ObjectFile, IncrementalStats &Stats);
+
+    void FindExportedFunctions();
+
     void HandleFunction(Expression *ParsedExpression);
 
     void HandleNative(std::unique_ptr<FunctionDeclaration> Declaration);
 
-    void HandleTopLevelExpression(Expression *ParsedExpression);
+    void HandleTopLevelExpression(FunctionDefinition *ParsedExpression);
+
+    void HandleCommand();
+
+    bool TryInterpret(FunctionDefinition *ParsedExpression);
+
+    void AddPendingModules();
+
+    // whether Module defines a function to add, rather than just declaring the functions it calls
+    static bool DefinesFunction(class Module &Module);
+
+    void RunInVM();
+
+    void PrintCodeMemoryStats();
 
     bool IsRepl() {
         return InputFile == "-";
     }
 
+    // the JIT runs top level expressions as it reads them, instead of compiling them into an object file
+    bool RunsInput() {
+        return IsRepl() || Run;
+    }
+
     bool HasOutputFile() {
         return OutputFile != "-";
     }
 
+    bool UsesVM() {
+        return Backend == Backend::VM;
+    }
+
     void IfReplPrint(const char *Message) {
-        if (IsRepl()) {
+        if (IsRepl() && !ReadingPrelude) {
             fprintf(stderr, "%s", Message);
         }
     }
@@ -0,0 +1,15 @@
+#include "ThreadPoolDispatcher.h"
+
+ThreadPoolDispatcher::ThreadPoolDispatcher(unsigned Threads) : Pool(hardware_concurrency(Threads)) {}
+
+void ThreadPoolDispatcher::dispatch(std::unique_ptr<Task> T) {
+    // the pool takes copyable functions only
+    std::shared_ptr<Task> SharedTask = std::move(T);
+    Pool.async([SharedTask]() {
+        SharedTask->run();
+    });
+}
+
+void ThreadPoolDispatcher::shutdown() {
+    Pool.wait();
+}
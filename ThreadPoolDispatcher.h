@@ -0,0 +1,26 @@
+#ifndef SOLID_LANG_THREADPOOLDISPATCHER_H
+#define SOLID_LANG_THREADPOOLDISPATCHER_H
+
+#include "llvm/ExecutionEngine/Orc/TaskDispatch.h"
+#include "llvm/Support/ThreadPool.h"
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Runs the session's tasks (materializing modules, linking objects, ...) on a fixed size thread pool,
+// so modules that are looked up together are compiled in parallel.
+class ThreadPoolDispatcher : public TaskDispatcher {
+
+public:
+    // Threads: number of worker threads, 0 for one per hardware thread
+    explicit ThreadPoolDispatcher(unsigned Threads);
+
+    void dispatch(std::unique_ptr<Task> T) override;
+
+    void shutdown() override;
+
+private:
+    ThreadPool Pool;
+};
+
+#endif
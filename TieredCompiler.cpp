@@ -0,0 +1,259 @@
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils.h"
+#include <algorithm>
+#include <atomic>
+#include "TieredCompiler.h"
+
+TieredCompiler::TieredCompiler(ExecutionSession &ES, IRLayer &Tier1Layer, JITDylib &Dylib, MangleAndInterner &Mangle,
+                               unsigned Threshold)
+        : ES(ES), Tier1Layer(Tier1Layer), Dylib(Dylib), Mangle(Mangle), Threshold(std::max(Threshold, 1u)) {}
+
+TieredCompiler::~TieredCompiler() {
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Stopping = true;
+    }
+    WorkAvailable.notify_all();
+
+    if (Worker.joinable())
+        Worker.join();
+}
+
+Error TieredCompiler::Start() {
+    auto Err = Dylib.define(absoluteSymbols({
+        {Mangle("__solid_tier_up"),
+            JITEvaluatedSymbol(pointerToJITTargetAddress(&TierUpHook), JITSymbolFlags::Exported)},
+        {Mangle("__solid_tier_up_context"),
+            JITEvaluatedSymbol(pointerToJITTargetAddress(this), JITSymbolFlags::Exported)}
+    }));
+    if (Err)
+        return Err;
+
+    Worker = std::thread([this]() { Run(); });
+    return Error::success();
+}
+
+bool TieredCompiler::IsTierable(const Function &Func) {
+    // top level expressions run once, there is nothing to gain from re-optimizing them.
+    // Internal functions (outlined loop bodies, spawned calls) are only used by their module and tier up with it.
+    return !Func.isDeclaration() && !Func.hasLocalLinkage() &&
+           !Func.getName().startswith("__anonymous_top_level_expr");
+}
+
+bool TieredCompiler::IsTierable(const ThreadSafeModule &TSM) {
+    return TSM.withModuleDo([](class Module &Mod) {
+        for (auto &Func: Mod) {
+            if (IsTierable(Func))
+                return true;
+        }
+        return false;
+    });
+}
+
+Expected<ThreadSafeModule> TieredCompiler::Instrument(ThreadSafeModule TSM) {
+    auto Tier1 = std::make_shared<Tier1Module>();
+    Tier1->Original = cloneToNewContext(TSM);
+
+    TSM.withModuleDo([&](class Module &Mod) {
+        auto PassManager = std::make_unique<legacy::FunctionPassManager>(&Mod);
+        PassManager->add(createPromoteMemoryToRegisterPass());
+        PassManager->add(createCFGSimplificationPass());
+        PassManager->doInitialization();
+
+        std::vector<Function *> Functions;
+        for (auto &Func: Mod) {
+            if (IsTierable(Func)) {
+                PassManager->run(Func);
+                Functions.push_back(&Func);
+            }
+        }
+
+        for (auto *Func: Functions) {
+            Tier1->Functions.push_back(Func->getName().str());
+            AddStub(Mod, *Func);
+        }
+    });
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    for (auto &Name: Tier1->Functions)
+        ModulesByFunction[Name] = Tier1;
+
+    return std::move(TSM);
+}
+
+void TieredCompiler::AddStub(class Module &Mod, Function &Func) {
+    LLVMContext &Context = Mod.getContext();
+    std::string Name = Func.getName().str();
+
+    Func.setName(Name + "$tier0");
+    auto *Stub = Function::Create(Func.getFunctionType(), Function::ExternalLinkage, Name, Mod);
+
+    // route recursive and sibling calls through the stub as well, so they are counted and switch tiers
+    Func.replaceAllUsesWith(Stub);
+    Func.setLinkage(GlobalValue::InternalLinkage);
+
+    auto *Impl = new GlobalVariable(Mod, Func.getType(), false, GlobalValue::InternalLinkage, &Func,
+                                    Name + "$impl");
+    auto *Calls = new GlobalVariable(Mod, Type::getInt64Ty(Context), false, GlobalValue::InternalLinkage,
+                                     ConstantInt::get(Type::getInt64Ty(Context), 0), Name + "$calls");
+
+    auto *HookType = FunctionType::get(Type::getVoidTy(Context),
+                                       {Type::getInt8PtrTy(Context), Type::getInt8PtrTy(Context), Impl->getType()},
+                                       false);
+    FunctionCallee Hook = Mod.getOrInsertFunction("__solid_tier_up", HookType);
+    Constant *HookContext = Mod.getOrInsertGlobal("__solid_tier_up_context", Type::getInt8Ty(Context));
+
+    BasicBlock *EntryBlock = BasicBlock::Create(Context, "entry", Stub);
+    BasicBlock *TierUpBlock = BasicBlock::Create(Context, "tierup", Stub);
+    BasicBlock *CallBlock = BasicBlock::Create(Context, "call", Stub);
+    IRBuilder<> Builder(EntryBlock);
+
+    // count calls (lossy under contention, which is fine for a heuristic)
+    LoadInst *Count = Builder.CreateAlignedLoad(Type::getInt64Ty(Context), Calls, Align(8), "calls");
+    Count->setAtomic(AtomicOrdering::Monotonic);
+    Value *NextCount = Builder.CreateAdd(Count, Builder.getInt64(1), "nextcalls");
+    StoreInst *Store = Builder.CreateAlignedStore(NextCount, Calls, Align(8));
+    Store->setAtomic(AtomicOrdering::Monotonic);
+
+    // the count only equals the threshold once, so a function asks to tier up once
+    Value *IsHot = Builder.CreateICmpEQ(NextCount, Builder.getInt64(Threshold), "hot");
+    Builder.CreateCondBr(IsHot, TierUpBlock, CallBlock);
+
+    // emit tier up request:
+    Builder.SetInsertPoint(TierUpBlock);
+    Builder.CreateCall(Hook, {HookContext, Builder.CreateGlobalStringPtr(Name, Name + "$name"), Impl});
+    Builder.CreateBr(CallBlock);
+
+    // emit call through the current implementation:
+    Builder.SetInsertPoint(CallBlock);
+    LoadInst *Target = Builder.CreateAlignedLoad(Func.getType(), Impl, Align(8), "impl");
+    Target->setAtomic(AtomicOrdering::Monotonic);
+
+    std::vector<Value *> Arguments;
+    for (auto &Argument: Stub->args())
+        Arguments.push_back(&Argument);
+
+    CallInst *Result = Builder.CreateCall(Func.getFunctionType(), Target, Arguments, "calltmp");
+    Result->setTailCallKind(CallInst::TCK_Tail);
+    Builder.CreateRet(Result);
+}
+
+void TieredCompiler::TierUpHook(TieredCompiler *Self, const char *Name, JITTargetAddress *Impl) {
+    Self->Request(Name, pointerToJITTargetAddress(Impl));
+}
+
+void TieredCompiler::Request(const std::string &Name, JITTargetAddress Impl) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    auto Found = ModulesByFunction.find(Name);
+    if (Found == ModulesByFunction.end())
+        return;
+
+    auto &Tier1 = *Found->second;
+    Tier1.Impls[Name] = Impl;
+
+    if (Tier1.Compiled) {
+        Switch(Impl, Tier1.Optimized[Name]);
+    } else if (!Tier1.Requested) {
+        Tier1.Requested = true;
+        Queue.push_back(Found->second);
+        WorkAvailable.notify_one();
+    }
+}
+
+void TieredCompiler::Switch(JITTargetAddress Impl, JITTargetAddress Optimized) {
+    // the stub loads this pointer on every call, so callers switch to tier 1 with their next call
+    auto *Target = jitTargetAddressToPointer<std::atomic<JITTargetAddress> *>(Impl);
+    Target->store(Optimized, std::memory_order_release);
+}
+
+void TieredCompiler::Run() {
+    while (true) {
+        std::shared_ptr<Tier1Module> Next;
+        {
+            std::unique_lock<std::mutex> Lock(Mutex);
+            WorkAvailable.wait(Lock, [this]() { return Stopping || !Queue.empty(); });
+            if (Stopping)
+                return;
+
+            Next = std::move(Queue.front());
+            Queue.pop_front();
+        }
+
+        if (auto Err = Compile(*Next))
+            ES.reportError(std::move(Err));
+    }
+}
+
+Error TieredCompiler::Remove(const std::string &Name) {
+    ResourceTrackerSP Tracker;
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        auto Found = ModulesByFunction.find(Name);
+        if (Found == ModulesByFunction.end())
+            return Error::success();
+
+        // the stubs' `$impl` pointers are gone with the tier 0 code, so they must not be switched anymore
+        auto &Tier1 = *Found->second;
+        Tier1.Impls.clear();
+        Tier1.Removed = true;
+        if (Tier1.Compiled)
+            Tracker = Tier1.Tracker;
+
+        for (auto &Function: Tier1.Functions)
+            ModulesByFunction.erase(Function);
+    }
+
+    // a module that is being compiled is removed when it's done
+    if (Tracker)
+        return Tracker->remove();
+    return Error::success();
+}
+
+Error TieredCompiler::Compile(Tier1Module &Tier1) {
+    ResourceTrackerSP Tracker;
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (Tier1.Removed)
+            return Error::success();
+
+        Tier1.Tracker = Dylib.createResourceTracker();
+        Tracker = Tier1.Tracker;
+    }
+
+    ThreadSafeModule TSM = std::move(Tier1.Original);
+    TSM.withModuleDo([](class Module &Mod) {
+        for (auto &Func: Mod) {
+            if (IsTierable(Func))
+                Func.setName(Func.getName() + "$tier1");
+        }
+    });
+
+    if (auto Err = Tier1Layer.add(Tracker, std::move(TSM)))
+        return Err;
+
+    std::map<std::string, JITTargetAddress> Optimized;
+    for (auto &Name: Tier1.Functions) {
+        auto Symbol = ES.lookup({&Dylib}, Mangle(Name + "$tier1"));
+        if (!Symbol)
+            return Symbol.takeError();
+        Optimized[Name] = Symbol->getAddress();
+    }
+
+    {
+        // switch the stubs that are hot already, the others switch once they become hot
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (!Tier1.Removed) {
+            Tier1.Optimized = std::move(Optimized);
+            Tier1.Compiled = true;
+            for (auto &Impl: Tier1.Impls)
+                Switch(Impl.second, Tier1.Optimized[Impl.first]);
+
+            return Error::success();
+        }
+    }
+
+    return Tracker->remove();
+}
@@ -0,0 +1,89 @@
+#ifndef SOLID_LANG_TIEREDCOMPILER_H
+#define SOLID_LANG_TIEREDCOMPILER_H
+
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/Layer.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+// Two-tier execution for JIT'd functions:
+// - tier 0: a function `f` is renamed to `f$tier0`, lightly optimized and called through a stub `f`.
+//   The stub counts calls and jumps through the pointer `f$impl`.
+// - tier 1: once a stub's counter reaches the threshold, a copy of the original module is optimized at O3
+//   on a background thread, its functions are added as `f$tier1` and the hot stubs are switched to them.
+class TieredCompiler {
+
+public:
+    TieredCompiler(ExecutionSession &ES, IRLayer &Tier1Layer, JITDylib &Dylib, MangleAndInterner &Mangle,
+                   unsigned Threshold);
+
+    ~TieredCompiler();
+
+    // Defines the symbols the stubs call into (`__solid_tier_up`, `__solid_tier_up_context`) in the dylib.
+    Error Start();
+
+    // Tier 0 transform: keeps a copy of the module for tier 1, optimizes lightly and inserts the stubs.
+    Expected<ThreadSafeModule> Instrument(ThreadSafeModule TSM);
+
+    // Whether the module defines any function that should go through the tiers.
+    static bool IsTierable(const ThreadSafeModule &TSM);
+
+    // Forgets a function that has been removed from the JIT (with its tier 0 code) and removes its tier 1 code.
+    Error Remove(const std::string &Name);
+
+private:
+    struct Tier1Module {
+        ThreadSafeModule Original;
+        std::vector<std::string> Functions;
+        bool Requested = false;
+        bool Compiled = false;
+        bool Removed = false;
+
+        // owns the tier 1 code
+        ResourceTrackerSP Tracker;
+
+        // addresses of the stubs' `$impl` pointers (by function name), registered when a stub becomes hot
+        std::map<std::string, JITTargetAddress> Impls;
+        std::map<std::string, JITTargetAddress> Optimized;
+    };
+
+    ExecutionSession &ES;
+    IRLayer &Tier1Layer;
+    JITDylib &Dylib;
+    MangleAndInterner &Mangle;
+    unsigned Threshold;
+
+    std::mutex Mutex;
+    std::condition_variable WorkAvailable;
+    std::map<std::string, std::shared_ptr<Tier1Module>> ModulesByFunction;
+    std::deque<std::shared_ptr<Tier1Module>> Queue;
+    bool Stopping = false;
+    std::thread Worker;
+
+    static bool IsTierable(const Function &Func);
+
+    // Called by tier 0 stubs (from JIT'd code) when a function crosses the threshold.
+    static void TierUpHook(TieredCompiler *Self, const char *Name, JITTargetAddress *Impl);
+
+    void Request(const std::string &Name, JITTargetAddress Impl);
+
+    static void Switch(JITTargetAddress Impl, JITTargetAddress Optimized);
+
+    void Run();
+
+    Error Compile(Tier1Module &Module);
+
+    void AddStub(class Module &Module, Function &Func);
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "llvm/Support/DynamicLibrary.h"
+#include "BuiltIns.h"
+#include "MathBuiltIns.h"
+#include "NativeCall.h"
+#include "VM.h"
+
+VM::VM() : Stack(new double[StackSize]) {
+    // make the symbols of the process available, like the JIT's DynamicLibrarySearchGenerator does
+    sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+unsigned VM::GetFunctionIndex(StringRef Name) {
+    auto Index = FunctionIndices.find(Name.str());
+    if (Index != FunctionIndices.end())
+        return Index->second;
+
+    Functions.push_back(nullptr);
+    FunctionIndices[Name.str()] = Functions.size() - 1;
+    return Functions.size() - 1;
+}
+
+void VM::Define(std::unique_ptr<BytecodeFunction> Function) {
+    unsigned Index = GetFunctionIndex(Function->Name);
+    Functions[Index] = std::move(Function);
+}
+
+void VM::Remove(StringRef Name) {
+    // keep the index, it's referenced by compiled calls
+    auto Index = FunctionIndices.find(Name.str());
+    if (Index != FunctionIndices.end())
+        Functions[Index->second] = nullptr;
+}
+
+void VM::Unreserve(StringRef Name) {
+    auto Index = FunctionIndices.find(Name.str());
+    if (Index == FunctionIndices.end() || Functions[Index->second])
+        return;
+
+    // nothing else is reserved while a function compiles, its index is the last one
+    if (Index->second == Functions.size() - 1)
+        Functions.pop_back();
+    FunctionIndices.erase(Index);
+}
+
+std::optional<unsigned> VM::GetNativeIndex(StringRef Name, unsigned Arity) {
+    auto Index = NativeIndices.find(Name.str());
+    if (Index != NativeIndices.end())
+        return Index->second;
+
+    if (Arity > MaxNativeArguments)
+        return std::nullopt;
+
+    void *Address = nullptr;
+    auto BuiltIn = GetBuiltIns().find(Name.str());
+    if (BuiltIn != GetBuiltIns().end())
+        Address = BuiltIn->second;
+    else if (const MathBuiltIn *Math = GetMathBuiltIn(Name))
+        Address = Math->Address;
+    else
+        Address = sys::DynamicLibrary::SearchForAddressOfSymbol(Name.str());
+    if (!Address)
+        return std::nullopt;
+
+    Natives.push_back({(uint64_t) (uintptr_t) Address, Arity});
+    NativeIndices[Name.str()] = Natives.size() - 1;
+    return Natives.size() - 1;
+}
+
+Expected<double> VM::Run(StringRef Name) {
+    auto Index = FunctionIndices.find(Name.str());
+    if (Index == FunctionIndices.end() || !Functions[Index->second])
+        return make_error<StringError>("Function " + Name + " not defined", inconvertibleErrorCode());
+
+    return Execute(*Functions[Index->second]);
+}
+
+Expected<double> VM::Execute(const BytecodeFunction &Entry) {
+    struct Frame {
+        const BytecodeFunction *Function;
+        const BytecodeInstruction *ReturnAddress;
+        double *Registers;
+        uint16_t Result;
+    };
+
+    std::vector<Frame> Frames;
+    Frames.reserve(256);
+
+    double *StackEnd = Stack.get() + StackSize;
+
+    const BytecodeFunction *Function = &Entry;
+    const BytecodeInstruction *IP = Function->Code.data();
+    const double *K = Function->Constants.data();
+    double *R = Stack.get();
+
+    if (R + Function->NumRegisters > StackEnd)
+        return make_error<StringError>("Stack overflow", inconvertibleErrorCode());
+
+#ifdef SOLID_VM_THREADED_DISPATCH
+    // same order as Opcode
+    static void *const Labels[] = {
+            &&Op_Const, &&Op_Move, &&Op_Add, &&Op_Sub, &&Op_Mul, &&Op_Less, &&Op_Jump, &&Op_JumpIfFalse,
+            &&Op_JumpIfTrue, &&Op_Call, &&Op_CallNative, &&Op_Return,
+    };
+#define DISPATCH() goto *Labels[static_cast<uint16_t>(IP->Op)]
+#define OPCODE(Name) Op_##Name:
+    DISPATCH();
+#else
+#define DISPATCH() goto Dispatch
+#define OPCODE(Name) case Opcode::Name:
+    Dispatch:
+    switch (IP->Op) {
+#endif
+
+    OPCODE(Const) {
+        R[IP->A] = K[IP->B];
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Move) {
+        R[IP->A] = R[IP->B];
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Add) {
+        R[IP->A] = R[IP->B] + R[IP->C];
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Sub) {
+        R[IP->A] = R[IP->B] - R[IP->C];
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Mul) {
+        R[IP->A] = R[IP->B] * R[IP->C];
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Less) {
+        // unordered or less than, like the generated IR
+        R[IP->A] = !(R[IP->B] >= R[IP->C]) ? 1.0 : 0.0;
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Jump) {
+        IP = Function->Code.data() + IP->B;
+        DISPATCH();
+    }
+
+    OPCODE(JumpIfFalse) {
+        // ordered and not equal to 0 is true
+        double Condition = R[IP->A];
+        IP = Condition < 0.0 || Condition > 0.0 ? IP + 1 : Function->Code.data() + IP->B;
+        DISPATCH();
+    }
+
+    OPCODE(JumpIfTrue) {
+        double Condition = R[IP->A];
+        IP = Condition < 0.0 || Condition > 0.0 ? Function->Code.data() + IP->B : IP + 1;
+        DISPATCH();
+    }
+
+    OPCODE(Call) {
+        const BytecodeFunction *Callee = Functions[IP->B].get();
+        if (!Callee)
+            return make_error<StringError>("Calling undefined function", inconvertibleErrorCode());
+
+        // the arguments are the last registers in use, so the callee's registers start at them
+        double *CalleeRegisters = R + IP->C;
+        if (CalleeRegisters + Callee->NumRegisters > StackEnd)
+            return make_error<StringError>("Stack overflow", inconvertibleErrorCode());
+
+        Frames.push_back({Function, IP + 1, R, IP->A});
+
+        Function = Callee;
+        IP = Callee->Code.data();
+        K = Callee->Constants.data();
+        R = CalleeRegisters;
+        DISPATCH();
+    }
+
+    OPCODE(CallNative) {
+        const NativeFunction &Native = Natives[IP->B];
+        R[IP->A] = CallNative(Native.Address, ArrayRef<double>(R + IP->C, Native.Arity));
+        ++IP;
+        DISPATCH();
+    }
+
+    OPCODE(Return) {
+        double Result = R[IP->A];
+        if (Frames.empty())
+            return Result;
+
+        const Frame &Caller = Frames.back();
+        Function = Caller.Function;
+        IP = Caller.ReturnAddress;
+        K = Function->Constants.data();
+        R = Caller.Registers;
+        R[Caller.Result] = Result;
+        Frames.pop_back();
+        DISPATCH();
+    }
+
+#ifndef SOLID_VM_THREADED_DISPATCH
+    }
+    return make_error<StringError>("Invalid instruction", inconvertibleErrorCode());
+#endif
+
+#undef DISPATCH
+#undef OPCODE
+}
@@ -0,0 +1,114 @@
+#ifndef SOLID_LANG_VM_H
+#define SOLID_LANG_VM_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// threaded dispatch needs computed gotos (labels as values), other compilers use a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define SOLID_VM_THREADED_DISPATCH
+#endif
+
+enum class Opcode : uint16_t {
+    // R[A] = Constants[B]
+    Const,
+    // R[A] = R[B]
+    Move,
+    // R[A] = R[B] <op> R[C]
+    Add,
+    Sub,
+    Mul,
+    Less,
+    // jump to B
+    Jump,
+    // jump to B if R[A] is (not) 0
+    JumpIfFalse,
+    JumpIfTrue,
+    // R[A] = Functions[B](R[C], R[C + 1], ...)
+    Call,
+    // R[A] = Natives[B](R[C], R[C + 1], ...)
+    CallNative,
+    // return R[A]
+    Return,
+};
+
+struct BytecodeInstruction {
+    Opcode Op;
+    uint16_t A;
+    uint16_t B;
+    uint16_t C;
+};
+
+struct BytecodeFunction {
+    std::string Name;
+    unsigned Arity = 0;
+    // arguments are in the first registers
+    unsigned NumRegisters = 0;
+    std::vector<BytecodeInstruction> Code;
+    std::vector<double> Constants;
+};
+
+struct NativeFunction {
+    uint64_t Address;
+    unsigned Arity;
+};
+
+// Register based virtual machine running the bytecode of BytecodeCompiler.
+// Starts without any LLVM code generation, for short scripts that run shorter than they would take to compile.
+class VM {
+
+public:
+    VM();
+
+    // Index of the function called Name, reserves one if it's not defined yet (for recursive calls)
+    unsigned GetFunctionIndex(StringRef Name);
+
+    // Whether Name is (or is being) compiled to bytecode
+    bool HasFunction(StringRef Name) const {
+        return FunctionIndices.count(Name.str()) != 0;
+    }
+
+    // Defines or redefines a function, existing calls use the new definition
+    void Define(std::unique_ptr<BytecodeFunction> Function);
+
+    bool IsDefined(StringRef Name) const {
+        auto Index = FunctionIndices.find(Name.str());
+        return Index != FunctionIndices.end() && Functions[Index->second];
+    }
+
+    void Remove(StringRef Name);
+
+    // Releases the index reserved for a function that failed to compile and was never defined, so calls to it don't
+    // compile
+    void Unreserve(StringRef Name);
+
+    // Index of a native function, resolved the same way the JIT resolves natives (nothing if not found)
+    std::optional<unsigned> GetNativeIndex(StringRef Name, unsigned Arity);
+
+    // Runs a function without arguments
+    Expected<double> Run(StringRef Name);
+
+private:
+    // number of registers of all active calls together
+    static const unsigned StackSize = 1024 * 1024;
+
+    std::vector<std::unique_ptr<BytecodeFunction>> Functions;
+    std::map<std::string, unsigned> FunctionIndices;
+
+    std::vector<NativeFunction> Natives;
+    std::map<std::string, unsigned> NativeIndices;
+
+    std::unique_ptr<double[]> Stack;
+
+    Expected<double> Execute(const BytecodeFunction &Function);
+};
+
+#endif
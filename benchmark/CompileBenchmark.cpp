@@ -0,0 +1,302 @@
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "IRGenerator.h"
+#include "Lexer.h"
+#include "Optimizer.h"
+#include "Parser.h"
+#include "ProgramGenerator.h"
+
+// Compile throughput of the phases of `solid_lang` on synthetic programs, scaled along one axis at a time:
+//
+//   ./solid_compile_benchmark --output=compile.json
+//   ./solid_compile_benchmark --generate=big.solid --size=100
+//
+// Every phase gets the output of the one before it: lexing (tokens), parsing (functions, lexing included), IR
+// generation (functions), the function passes of object files and the O2 pipeline (instructions before them) and
+// object emission (instructions).
+
+cl::OptionCategory BenchmarkCategory("Benchmark options");
+cl::opt<std::string> OutputFile("output", cl::desc("JSON results (default: stdout)"), cl::value_desc("file"),
+                                cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Repetitions("repetitions", cl::desc("Runs of every program, the median is reported"), cl::init(3),
+                              cl::cat(BenchmarkCategory));
+cl::opt<unsigned> MaxSize("max-size", cl::desc("Largest program of the size axis (1, 10, 100, ...)"),
+                          cl::value_desc("MB"), cl::init(10), cl::cat(BenchmarkCategory));
+cl::opt<std::string> Generate("generate", cl::desc("Only write a program of the shape below into this file"),
+                              cl::value_desc("file"), cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Functions("functions", cl::desc("Functions of the generated program"), cl::init(1000),
+                            cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Depth("depth", cl::desc("Expression depth of the generated program"), cl::init(4),
+                        cl::cat(BenchmarkCategory));
+cl::opt<unsigned> LetNesting("let-nesting", cl::desc("Nested lets of every function of the generated program"),
+                             cl::init(1), cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Operators("operators", cl::desc("Operators defined by the generated program"), cl::init(0),
+                            cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Size("size", cl::desc("Size of the generated program instead of a number of functions"),
+                       cl::value_desc("MB"), cl::init(0), cl::cat(BenchmarkCategory));
+cl::opt<uint64_t> Seed("seed", cl::desc("Seed of the generated programs"), cl::init(1), cl::cat(BenchmarkCategory));
+
+namespace {
+
+const uint64_t Megabyte = 1024 * 1024;
+
+enum BenchmarkPhase {
+    Lexing,
+    Parsing,
+    IRGeneration,
+    FunctionPasses,
+    O2Pipeline,
+    ObjectEmission,
+    PhaseCount,
+};
+
+const char *PhaseNames[PhaseCount] = {"lexing", "parsing", "ir_generation", "function_passes", "o2_pipeline",
+                                      "object_emission"};
+
+const char *PhaseItems[PhaseCount] = {"tokens", "functions", "functions", "instructions", "instructions",
+                                      "instructions"};
+
+struct Scale {
+    std::string Axis;
+    ProgramShape Shape;
+};
+
+struct Measurement {
+    std::vector<double> Seconds;
+    uint64_t Items = 0;
+};
+
+double Now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::unique_ptr<TargetMachine> CreateTargetMachine() {
+    auto TargetTriple = sys::getDefaultTargetTriple();
+
+    std::string Error;
+    auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
+    if (!Target) {
+        fprintf(stderr, "Error: %s\n", Error.c_str());
+        exit(1);
+    }
+
+    return std::unique_ptr<TargetMachine>(
+            Target->createTargetMachine(TargetTriple, "generic", "", TargetOptions(), Reloc::PIC_));
+}
+
+// one run through all phases, adds the time of every phase to Measurements
+void CompileOnce(const std::string &Program, TargetMachine &Machine, Measurement Measurements[PhaseCount]) {
+    unsigned Errors = 0;
+    auto OnError = [&](const std::string &Message) {
+        if (Errors++ == 0)
+            fprintf(stderr, "Error: %s\n", Message.c_str());
+    };
+
+    double Start = Now();
+    Lexer TokenLexer(Program);
+    uint64_t Tokens = 0;
+    while (TokenLexer.GetNextToken() != t_eof)
+        ++Tokens;
+    Measurements[Lexing].Seconds.push_back(Now() - Start);
+    Measurements[Lexing].Items = Tokens;
+
+    Start = Now();
+    Lexer Lexer(Program);
+    Parser Parser(Lexer, OnError);
+    std::vector<std::unique_ptr<FunctionDefinition>> Definitions;
+    Lexer.GetNextToken();
+    while (Lexer.GetCurrentToken() != t_eof) {
+        if (Lexer.GetCurrentToken() == ';') {
+            Lexer.GetNextToken();
+            continue;
+        }
+
+        auto Definition = Parser.ParseFunctionDefinition();
+        if (!Definition) {
+            Lexer.GetNextToken();
+            continue;
+        }
+        Definitions.push_back(std::move(Definition));
+    }
+    Measurements[Parsing].Seconds.push_back(Now() - Start);
+    Measurements[Parsing].Items = Definitions.size();
+
+    Start = Now();
+    LLVMContext Context;
+    Module Module("benchmark", Context);
+    Module.setTargetTriple(Machine.getTargetTriple().str());
+    Module.setDataLayout(Machine.createDataLayout());
+    IRBuilder<> Builder(Context);
+    std::map<std::string, AllocaInst *> ValuesByName;
+    std::map<std::string, std::unique_ptr<FunctionDeclaration>> FunctionDeclarations;
+    IRGenerator Generator(Context, Builder, Module, nullptr, ValuesByName, FunctionDeclarations, OnError);
+    for (auto &Definition: Definitions)
+        Definition->Accept(Generator);
+    Measurements[IRGeneration].Seconds.push_back(Now() - Start);
+    Measurements[IRGeneration].Items = Module.size();
+
+    // the passes InitLLVM runs on the functions of object files
+    Measurements[FunctionPasses].Items = Module.getInstructionCount();
+    Start = Now();
+    legacy::FunctionPassManager PassManager(&Module);
+    PassManager.add(createPromoteMemoryToRegisterPass());
+    PassManager.add(createInstructionCombiningPass());
+    PassManager.add(createReassociatePass());
+    PassManager.add(createGVNPass());
+    PassManager.add(createCFGSimplificationPass());
+    PassManager.doInitialization();
+    for (auto &Function: Module)
+        PassManager.run(Function);
+    Measurements[FunctionPasses].Seconds.push_back(Now() - Start);
+
+    Measurements[O2Pipeline].Items = Module.getInstructionCount();
+    Start = Now();
+    RunOptimizationPipeline(Module, OptimizationLevel::O2, &Machine);
+    Measurements[O2Pipeline].Seconds.push_back(Now() - Start);
+
+    Measurements[ObjectEmission].Items = Module.getInstructionCount();
+    Start = Now();
+    SmallVector<char, 0> Object;
+    raw_svector_ostream ObjectStream(Object);
+    legacy::PassManager OutputPassManager;
+    Machine.addPassesToEmitFile(OutputPassManager, ObjectStream, nullptr, CGFT_ObjectFile);
+    OutputPassManager.run(Module);
+    Measurements[ObjectEmission].Seconds.push_back(Now() - Start);
+
+    if (Errors)
+        fprintf(stderr, "%u errors compiling the generated program\n", Errors);
+}
+
+double Median(std::vector<double> Values) {
+    std::sort(Values.begin(), Values.end());
+    return Values[Values.size() / 2];
+}
+
+std::vector<Scale> GetScales() {
+    ProgramShape Baseline;
+    Baseline.Functions = 1000;
+    Baseline.ExpressionDepth = 4;
+    Baseline.LetNesting = 1;
+    Baseline.Seed = Seed;
+
+    std::vector<Scale> Scales;
+    for (unsigned Count: {100u, 1000u, 10000u}) {
+        Scales.push_back({"functions", Baseline});
+        Scales.back().Shape.Functions = Count;
+    }
+    for (unsigned ExpressionDepth: {2u, 4u, 6u, 8u}) {
+        Scales.push_back({"expression_depth", Baseline});
+        Scales.back().Shape.ExpressionDepth = ExpressionDepth;
+    }
+    for (unsigned Lets: {0u, 4u, 16u}) {
+        Scales.push_back({"let_nesting", Baseline});
+        Scales.back().Shape.LetNesting = Lets;
+    }
+    for (unsigned Count: {0u, 4u, 12u}) {
+        Scales.push_back({"operators", Baseline});
+        Scales.back().Shape.Operators = Count;
+    }
+    for (uint64_t Megabytes = 1; Megabytes <= MaxSize; Megabytes *= 10) {
+        Scales.push_back({"size", Baseline});
+        Scales.back().Shape.Bytes = Megabytes * Megabyte;
+    }
+    return Scales;
+}
+
+}
+
+int main(int argc, char **argv) {
+    cl::HideUnrelatedOptions(BenchmarkCategory);
+    cl::ParseCommandLineOptions(argc, argv, "Compile throughput of the Solid compiler");
+
+    if (!Generate.empty()) {
+        ProgramShape Shape;
+        Shape.Functions = Functions;
+        Shape.ExpressionDepth = Depth;
+        Shape.LetNesting = LetNesting;
+        Shape.Operators = Operators;
+        Shape.Bytes = Size * Megabyte;
+        Shape.Seed = Seed;
+
+        std::error_code ErrorCode;
+        raw_fd_ostream Out(Generate, ErrorCode, sys::fs::OF_Text);
+        if (ErrorCode) {
+            fprintf(stderr, "Error: could not open %s\n", Generate.c_str());
+            return 1;
+        }
+        Out << GenerateProgram(Shape);
+        return 0;
+    }
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    auto Machine = CreateTargetMachine();
+
+    std::error_code ErrorCode;
+    raw_fd_ostream Out(OutputFile.empty() ? "-" : OutputFile.getValue(), ErrorCode, sys::fs::OF_Text);
+    if (ErrorCode) {
+        fprintf(stderr, "Error: could not open %s\n", OutputFile.c_str());
+        return 1;
+    }
+
+    json::OStream JSON(Out, 2);
+    JSON.object([&]() {
+        JSON.attribute("target", Machine->getTargetTriple().str());
+        JSON.attribute("repetitions", (int64_t) Repetitions);
+        JSON.attributeArray("benchmarks", [&]() {
+            for (auto &Scale: GetScales()) {
+                std::string Program = GenerateProgram(Scale.Shape);
+
+                Measurement Measurements[PhaseCount];
+                for (unsigned i = 0; i < std::max(1u, (unsigned) Repetitions); ++i)
+                    CompileOnce(Program, *Machine, Measurements);
+
+                double Megabytes = (double) Program.size() / Megabyte;
+                fprintf(stderr, "%-16s %8.2f MB:", Scale.Axis.c_str(), Megabytes);
+
+                JSON.object([&]() {
+                    JSON.attribute("axis", Scale.Axis);
+                    JSON.attributeObject("shape", [&]() {
+                        JSON.attribute("functions", (int64_t) Measurements[Parsing].Items);
+                        JSON.attribute("expression_depth", (int64_t) Scale.Shape.ExpressionDepth);
+                        JSON.attribute("let_nesting", (int64_t) Scale.Shape.LetNesting);
+                        JSON.attribute("operators", (int64_t) Scale.Shape.Operators);
+                        JSON.attribute("bytes", (int64_t) Program.size());
+                    });
+                    JSON.attributeObject("phases", [&]() {
+                        for (int Phase = 0; Phase < PhaseCount; ++Phase) {
+                            double Seconds = Median(Measurements[Phase].Seconds);
+                            uint64_t Items = Measurements[Phase].Items;
+                            fprintf(stderr, "  %s %.1f MB/s", PhaseNames[Phase], Megabytes / Seconds);
+
+                            JSON.attributeObject(PhaseNames[Phase], [&]() {
+                                JSON.attribute("seconds", Seconds);
+                                JSON.attribute(PhaseItems[Phase], (int64_t) Items);
+                                JSON.attribute("items_per_second", Items / Seconds);
+                                JSON.attribute("megabytes_per_second", Megabytes / Seconds);
+                            });
+                        }
+                    });
+                });
+                fprintf(stderr, "\n");
+            }
+        });
+    });
+    Out << "\n";
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <random>
+#include <vector>
+#include "ProgramGenerator.h"
+
+namespace {
+
+// characters that aren't tokens of their own yet
+const char OperatorCharacters[] = "|&^%>!?@$~:/";
+const unsigned MaxOperators = sizeof(OperatorCharacters) - 1;
+
+class Generator {
+    const ProgramShape &Shape;
+    std::mt19937_64 Random;
+    std::string Program;
+    std::string Operators = "+-*<";
+    std::vector<std::string> Variables;
+    unsigned Functions = 0;
+
+    unsigned Choose(unsigned Count) {
+        return (unsigned) (Random() % Count);
+    }
+
+    void GenerateLeaf() {
+        if (Choose(5) < 3)
+            Program += Variables[Choose(Variables.size())];
+        else
+            Program += std::to_string(Choose(100));
+    }
+
+    void GenerateExpression(unsigned Depth) {
+        if (Depth == 0) {
+            GenerateLeaf();
+            return;
+        }
+
+        switch (Choose(8)) {
+            case 0:
+                Program += "(when ";
+                GenerateExpression(Depth - 1);
+                Program += " < ";
+                GenerateLeaf();
+                Program += " then ";
+                GenerateExpression(Depth - 1);
+                Program += " otherwise ";
+                GenerateLeaf();
+                Program += ")";
+                break;
+            case 1:
+                if (Functions > 0) {
+                    Program += "f" + std::to_string(Choose(Functions)) + "(";
+                    GenerateExpression(Depth - 1);
+                    Program += ", ";
+                    GenerateLeaf();
+                    Program += ", ";
+                    GenerateLeaf();
+                    Program += ")";
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                Program += "(";
+                GenerateExpression(Depth - 1);
+                Program += " ";
+                Program += Operators[Choose(Operators.size())];
+                Program += " ";
+                GenerateExpression(Depth - 1);
+                Program += ")";
+                break;
+        }
+    }
+
+    void GenerateFunction() {
+        Variables = {"a", "b", "c"};
+        Program += "func f" + std::to_string(Functions) + "(a b c)";
+
+        for (unsigned i = 0; i < Shape.LetNesting; ++i) {
+            std::string Name = "v" + std::to_string(i);
+            Program += " let " + Name + " = ";
+            GenerateExpression(std::min(Shape.ExpressionDepth, 2u));
+            Program += " in";
+            Variables.push_back(Name);
+        }
+
+        Program += " ";
+        GenerateExpression(Shape.ExpressionDepth);
+        Program += ";\n";
+        ++Functions;
+    }
+
+public:
+    explicit Generator(const ProgramShape &Shape) : Shape(Shape), Random(Shape.Seed) {}
+
+    std::string Generate() {
+        for (unsigned i = 0; i < std::min(Shape.Operators, MaxOperators); ++i) {
+            char Operator = OperatorCharacters[i];
+            Program += "operator binary " + std::string(1, Operator) + " " + std::to_string(5 + Choose(40)) +
+                       " (L R) L * 0.5 + R;\n";
+            Operators += Operator;
+        }
+
+        if (Shape.Bytes) {
+            while (Program.size() < Shape.Bytes)
+                GenerateFunction();
+        } else {
+            for (unsigned i = 0; i < Shape.Functions; ++i)
+                GenerateFunction();
+        }
+
+        return std::move(Program);
+    }
+};
+
+}
+
+std::string GenerateProgram(const ProgramShape &Shape) {
+    return Generator(Shape).Generate();
+}
@@ -0,0 +1,25 @@
+#ifndef SOLID_LANG_PROGRAMGENERATOR_H
+#define SOLID_LANG_PROGRAMGENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+// Size and shape of a synthetic program
+struct ProgramShape {
+    unsigned Functions = 100;
+    // levels of nested binary expressions, conditionals and calls in function bodies (leaves are at depth 0)
+    unsigned ExpressionDepth = 4;
+    // nested `let ... in` around every function body
+    unsigned LetNesting = 1;
+    // binary operators defined (up to 12) and used next to the built-in ones
+    unsigned Operators = 0;
+    // functions are added until the program has this many bytes (0: just Functions)
+    uint64_t Bytes = 0;
+    uint64_t Seed = 1;
+};
+
+// Generates a valid program of the given shape, the same one for the same shape and seed. Functions take three
+// arguments and call the functions defined before them.
+std::string GenerateProgram(const ProgramShape &Shape);
+
+#endif
@@ -0,0 +1,316 @@
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/TargetParser/Host.h"
+#include <dlfcn.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include "Session.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Run time of the kernels in Kernels.solid next to their C++ twins, JIT'd (as compiled by default, tiered and
+// specialized at O3) and compiled ahead of time at -O0 to -O3 (shared libraries CMake builds, `kernels_O<n>.so`):
+//
+//   make runtime_benchmark
+//   ./solid_runtime_benchmark --repetitions=50 --output=runtime.json
+//
+// Every kernel is called Warmup times first, then timed Repetitions times with the steady clock and the cycle counter
+// (the TSC on x86, the virtual counter on ARM).
+
+cl::OptionCategory BenchmarkCategory("Benchmark options");
+cl::opt<std::string> OutputFile("output", cl::desc("JSON results (default: stdout)"), cl::value_desc("file"),
+                                cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Warmup("warmup", cl::desc("Untimed calls of every kernel"), cl::init(3), cl::cat(BenchmarkCategory));
+cl::opt<unsigned> Repetitions("repetitions", cl::desc("Timed calls of every kernel"), cl::init(20),
+                              cl::cat(BenchmarkCategory));
+cl::opt<std::string> KernelsFile("kernels", cl::desc("Source of the JIT'd kernels"), cl::value_desc("file"),
+                                 cl::init(SOLID_BENCHMARK_KERNELS), cl::cat(BenchmarkCategory));
+cl::opt<std::string> LibraryDirectory("libraries", cl::desc("Directory of the kernels compiled ahead of time"),
+                                      cl::value_desc("directory"), cl::init(SOLID_BENCHMARK_LIBRARIES),
+                                      cl::cat(BenchmarkCategory));
+cl::opt<std::string> Filter("filter", cl::desc("Only run the kernels whose names contain this"),
+                            cl::cat(BenchmarkCategory));
+
+using KernelFunction = double (*)(double);
+
+namespace {
+
+double fib(double x) {
+    return x < 3 ? 1 : fib(x - 1) + fib(x - 2);
+}
+
+double fib2(double x) {
+    double a = 1, b = 1, c, i = 3;
+    do {
+        c = a + b;
+        a = b;
+        b = c < 1000000000 ? c : c - 1000000000;
+    } while (i++ < x);
+    return b;
+}
+
+double operators(double n) {
+    double Sum = 0, i = 0;
+    do {
+        Sum += 1000 < i ? i * 0.5 + 3 : i != 0 ? 0 : 1;
+    } while (i++ < n);
+    return Sum;
+}
+
+double natives(double n) {
+    double Sum = 0, i = 0;
+    do {
+        Sum += hypot(i, 3);
+    } while (i++ < n);
+    return Sum;
+}
+
+double waves(double n) {
+    double Sum = 0, i = 0;
+    do {
+        Sum += sin(i * 0.001) * sqrt(i);
+    } while (i++ < n);
+    return Sum;
+}
+
+double horner(double n) {
+    double Sum = 0, i = 0;
+    do {
+        double x = i * 0.0001;
+        Sum += ((x * 3 + 2) * x - 5) * x + 1;
+    } while (i++ < n);
+    return Sum;
+}
+
+struct Kernel {
+    const char *Name;
+    double Argument;
+    KernelFunction Reference;
+};
+
+const Kernel Kernels[] = {
+        {"fib", 30, fib},
+        {"fib2", 1e7, fib2},
+        {"operators", 1e7, operators},
+        {"natives", 1e6, natives},
+        {"waves", 1e6, waves},
+        {"horner", 1e7, horner},
+};
+
+struct Distribution {
+    double Min = 0, Mean = 0, P50 = 0, P90 = 0, P99 = 0, Max = 0;
+};
+
+struct Result {
+    std::string Kernel;
+    std::string Mode;
+    double Value;
+    bool MatchesReference;
+    Distribution Nanoseconds;
+    Distribution Cycles;
+};
+
+uint64_t ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t Ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(Ticks));
+    return Ticks;
+#else
+    return 0;
+#endif
+}
+
+// nearest rank percentiles
+Distribution Summarize(std::vector<double> Values) {
+    std::sort(Values.begin(), Values.end());
+    auto Percentile = [&](double Percent) {
+        size_t Rank = (size_t) std::ceil(Percent / 100 * Values.size());
+        return Values[std::min(Values.size() - 1, Rank > 0 ? Rank - 1 : 0)];
+    };
+
+    Distribution Distribution;
+    Distribution.Min = Values.front();
+    Distribution.Max = Values.back();
+    for (double Value: Values)
+        Distribution.Mean += Value / Values.size();
+    Distribution.P50 = Percentile(50);
+    Distribution.P90 = Percentile(90);
+    Distribution.P99 = Percentile(99);
+    return Distribution;
+}
+
+Result Measure(const Kernel &Kernel, const std::string &Mode, KernelFunction Function) {
+    // called through a pointer the compiler can't see through, so the C++ twins aren't folded either
+    KernelFunction volatile Call = Function;
+
+    double Value = 0;
+    for (unsigned i = 0; i < Warmup; ++i)
+        Value = Call(Kernel.Argument);
+
+    std::vector<double> Nanoseconds, Cycles;
+    for (unsigned i = 0; i < std::max(1u, (unsigned) Repetitions); ++i) {
+        auto Start = std::chrono::steady_clock::now();
+        uint64_t StartCycles = ReadCycles();
+        Value = Call(Kernel.Argument);
+        uint64_t EndCycles = ReadCycles();
+        auto End = std::chrono::steady_clock::now();
+
+        Nanoseconds.push_back((double) std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start).count());
+        Cycles.push_back((double) (EndCycles - StartCycles));
+    }
+
+    // optimized reductions may add in another order
+    double Expected = Kernel.Reference(Kernel.Argument);
+    bool Matches = Value == Expected || std::fabs(Value - Expected) <= 1e-6 * std::fabs(Expected);
+    if (!Matches) {
+        fprintf(stderr, "%s (%s) returned %f instead of %f\n", Kernel.Name, Mode.c_str(), Value, Expected);
+    }
+
+    return {Kernel.Name, Mode, Value, Matches, Summarize(Nanoseconds), Summarize(Cycles)};
+}
+
+bool Selected(const Kernel &Kernel) {
+    return StringRef(Kernel.Name).contains(Filter);
+}
+
+void MeasureAll(const std::string &Mode, const std::function<Expected<KernelFunction>(const Kernel &)> &Lookup,
+                std::vector<Result> &Results) {
+    for (auto &Kernel: Kernels) {
+        if (!Selected(Kernel))
+            continue;
+
+        auto Function = Lookup(Kernel);
+        if (!Function) {
+            fprintf(stderr, "%s (%s): %s\n", Kernel.Name, Mode.c_str(), toString(Function.takeError()).c_str());
+            continue;
+        }
+
+        Results.push_back(Measure(Kernel, Mode, *Function));
+        fprintf(stderr, "%-10s %-12s %12.3f ms\n", Kernel.Name, Mode.c_str(), Results.back().Nanoseconds.P50 / 1e6);
+    }
+}
+
+Error MeasureJIT(const std::string &Mode, const std::string &Source, const JITOptions &Options, bool Specialize,
+                 std::vector<Result> &Results) {
+    auto Session = Session::Create(Options);
+    if (!Session)
+        return Session.takeError();
+    if (auto Err = (*Session)->Compile(Source))
+        return Err;
+
+    MeasureAll(Mode, [&](const Kernel &Kernel) {
+        // a version without bound arguments is the function compiled at O3
+        return Specialize ? (*Session)->Specialize<double>(Kernel.Name, {})
+                          : (*Session)->GetFunction<double>(Kernel.Name);
+    }, Results);
+    return Error::success();
+}
+
+Error MeasureLibrary(unsigned Level, std::vector<Result> &Results) {
+    std::string Path = LibraryDirectory + "/kernels_O" + std::to_string(Level) + ".so";
+    void *Library = dlopen(Path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!Library)
+        return make_error<StringError>(dlerror(), inconvertibleErrorCode());
+
+    MeasureAll("aot-O" + std::to_string(Level), [&](const Kernel &Kernel) -> Expected<KernelFunction> {
+        auto *Function = (KernelFunction) dlsym(Library, Kernel.Name);
+        if (!Function)
+            return make_error<StringError>(Path + " doesn't define it", inconvertibleErrorCode());
+        return Function;
+    }, Results);
+
+    dlclose(Library);
+    return Error::success();
+}
+
+void WriteDistribution(json::OStream &JSON, StringRef Name, const Distribution &Distribution) {
+    JSON.attributeObject(Name, [&]() {
+        JSON.attribute("min", Distribution.Min);
+        JSON.attribute("mean", Distribution.Mean);
+        JSON.attribute("p50", Distribution.P50);
+        JSON.attribute("p90", Distribution.P90);
+        JSON.attribute("p99", Distribution.P99);
+        JSON.attribute("max", Distribution.Max);
+    });
+}
+
+}
+
+int main(int argc, char **argv) {
+    cl::HideUnrelatedOptions(BenchmarkCategory);
+    cl::ParseCommandLineOptions(argc, argv, "Run time of Solid kernels next to C++");
+
+    auto Source = MemoryBuffer::getFile(KernelsFile);
+    if (!Source) {
+        fprintf(stderr, "Error: could not read %s\n", KernelsFile.c_str());
+        return 1;
+    }
+
+    std::vector<Result> Results;
+    MeasureAll("cpp", [](const Kernel &Kernel) -> Expected<KernelFunction> { return Kernel.Reference; }, Results);
+
+    JITOptions Tiered;
+    Tiered.Tiered = true;
+    // the loops are only called a few times, the first repetitions may still run tier 0 code
+    Tiered.TierUpThreshold = 1;
+
+    auto Report = [](const char *Mode, Error Err) {
+        if (Err)
+            fprintf(stderr, "Error: %s: %s\n", Mode, toString(std::move(Err)).c_str());
+    };
+    std::string KernelSource = (*Source)->getBuffer().str();
+    Report("jit", MeasureJIT("jit", KernelSource, JITOptions(), false, Results));
+    Report("jit-tiered", MeasureJIT("jit-tiered", KernelSource, Tiered, false, Results));
+    Report("jit-O3", MeasureJIT("jit-O3", KernelSource, JITOptions(), true, Results));
+    for (unsigned Level = 0; Level <= 3; ++Level)
+        Report("aot", MeasureLibrary(Level, Results));
+
+    std::map<std::string, double> ReferenceTimes;
+    for (auto &Result: Results) {
+        if (Result.Mode == "cpp")
+            ReferenceTimes[Result.Kernel] = Result.Nanoseconds.P50;
+    }
+
+    std::error_code ErrorCode;
+    raw_fd_ostream Out(OutputFile.empty() ? "-" : OutputFile.getValue(), ErrorCode, sys::fs::OF_Text);
+    if (ErrorCode) {
+        fprintf(stderr, "Error: could not open %s\n", OutputFile.c_str());
+        return 1;
+    }
+
+    json::OStream JSON(Out, 2);
+    JSON.object([&]() {
+        JSON.attribute("target", sys::getProcessTriple());
+        JSON.attribute("cpu", sys::getHostCPUName());
+        JSON.attribute("warmup", (int64_t) Warmup);
+        JSON.attribute("repetitions", (int64_t) std::max(1u, (unsigned) Repetitions));
+        JSON.attributeArray("results", [&]() {
+            for (auto &Result: Results) {
+                JSON.object([&]() {
+                    JSON.attribute("kernel", Result.Kernel);
+                    JSON.attribute("mode", Result.Mode);
+                    JSON.attribute("value", Result.Value);
+                    JSON.attribute("matches_reference", Result.MatchesReference);
+                    // median time relative to the C++ twin
+                    JSON.attribute("relative_to_cpp", Result.Nanoseconds.P50 / ReferenceTimes[Result.Kernel]);
+                    WriteDistribution(JSON, "nanoseconds", Result.Nanoseconds);
+                    WriteDistribution(JSON, "cycles", Result.Cycles);
+                });
+            }
+        });
+    });
+    Out << "\n";
+
+    bool Mismatches = any_of(Results, [](const Result &Result) { return !Result.MatchesReference; });
+    return Mismatches ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+# Writes the bytes of INPUT to OUTPUT as a list of hex literals, to be included into an array initializer.
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<file> -P EmbedFile.cmake
+file(READ ${INPUT} Content HEX)
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," Content "${Content}")
+file(WRITE ${OUTPUT} "${Content}\n")
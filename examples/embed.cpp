@@ -0,0 +1,42 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "Session.h"
+
+/*
+ * 1) Build the library (libsolid.a) with the compiler:
+ * cmake -S .. -B build && cmake --build build
+ *
+ * 2) Link this program to it:
+ * clang++ -std=c++17 embed.cpp -I.. $(llvm-config --cxxflags) build/libsolid.a $(llvm-config --ldflags --libs) -o embed
+ *
+ * 3) Run it:
+ * ./embed
+*/
+int main() {
+    ExitOnError OnErrorExit;
+
+    auto Session = OnErrorExit(Session::Create());
+    OnErrorExit(Session->Compile(
+            "func fac(x) when x < 2 then 1 otherwise x * fac(x - 1);"
+            "func avg(x y) (x + y) * 0.5;"
+    ));
+
+    auto Fac = OnErrorExit(Session->GetFunction<double>("fac"));
+    auto Avg = OnErrorExit(Session->GetFunction<double, double>("avg"));
+
+    // compiled once, called from as many threads as needed
+    std::vector<std::thread> Threads;
+    for (int i = 0; i < 4; i++) {
+        Threads.emplace_back([=]() {
+            double Sum = 0;
+            for (int n = 0; n < 1000000; n++)
+                Sum += Avg(Fac(i + 1), n);
+            std::cout << "thread " << i << ": " << Sum << std::endl;
+        });
+    }
+    for (auto &Thread: Threads)
+        Thread.join();
+
+    std::cout << "fac(5) + 1 = " << OnErrorExit(Session->Evaluate("fac(5) + 1")) << std::endl;
+}
@@ -1,23 +1,189 @@
 #include "SolidLang.h"
+#include "OutputRuntime.h"
+#include "DataRuntime.h"
+#include "Driver.h"
+#include "CompileStats.h"
 
 cl::OptionCategory Compiler("Compiler options");
-cl::opt<std::string> InputFile(cl::Positional, cl::desc("<input filename>"), cl::init("-"), cl::cat(Compiler));
+cl::list<std::string> InputFiles(cl::Positional, cl::desc("<input files>"), cl::cat(Compiler));
 cl::opt<std::string> OutputFile("o", cl::desc("Output filename"), cl::value_desc("filename"), cl::init("-"),
                                 cl::cat(Compiler));
+cl::opt<std::string> Prelude("prelude", cl::desc("File read before every input, e.g. with shared natives and operators"),
+                            cl::value_desc("file"), cl::cat(Compiler));
+cl::opt<unsigned> Jobs("j", cl::desc("Number of input files compiled at the same time (0: one per core)"),
+                       cl::init(0), cl::cat(Compiler));
+cl::opt<Emit> EmitOutput("emit", cl::desc("What the program is compiled to, with a header declaring its functions"),
+                         cl::values(clEnumValN(Emit::Object, "object", "Object file (.o)"),
+                                    clEnumValN(Emit::Shared, "shared", "Shared library to dlopen (.so)"),
+                                    clEnumValN(Emit::Archive, "archive", "Static archive (.a)")),
+                         cl::init(Emit::Object), cl::cat(Compiler));
+cl::opt<std::string> RuntimeDirectory("runtime-dir", cl::desc("Where shared libraries load the runtime from (default: "
+                                                             "their own directory)"),
+                                      cl::value_desc("directory"), cl::cat(Compiler));
+cl::opt<unsigned> OptLevel("O", cl::desc("Optimization level of object files: 0, 1, 2 or 3 (default: 2)"),
+                           cl::Prefix, cl::init(2), cl::cat(Compiler));
 cl::opt<bool> PrintIR("IR", cl::desc("Print generated LLVM IR"), cl::cat(Compiler));
+cl::opt<Backend> ExecutionBackend("backend", cl::desc("Execution backend"),
+                                  cl::values(clEnumValN(Backend::JIT, "jit", "Compile to machine code with LLVM"),
+                                             clEnumValN(Backend::VM, "vm", "Run input on the bytecode VM")),
+                                  cl::init(Backend::JIT), cl::cat(Compiler));
+cl::opt<bool> Interpret("interpret", cl::desc("Evaluate simple REPL expressions without compiling them"),
+                        cl::init(true), cl::cat(Compiler));
+cl::opt<std::string> PrintTo("print-to", cl::desc("Where print and printc write: stdout, stderr or a file "
+                                                  "(default: $SOLID_OUTPUT or stderr)"),
+                             cl::value_desc("sink"), cl::cat(Compiler));
+cl::opt<bool> Run("run", cl::desc("Run the input file with the JIT instead of compiling it to an object file"),
+                  cl::cat(Compiler));
+cl::list<std::string> DataFiles("data", cl::desc("File the data built-ins read, numbered from 0 (after $SOLID_DATA)"),
+                                cl::value_desc("file"), cl::cat(Compiler));
+cl::opt<bool> PrintBinary("print-binary", cl::desc("Make print write the 8 bytes of its number instead of text"),
+                          cl::cat(Compiler));
+
+cl::opt<bool> TimeReport("time-report", cl::desc("Print the time and memory compile phases take, like --stats=text"),
+                         cl::cat(Compiler));
+cl::opt<std::string> StatsFile("stats-file", cl::desc("Where the stats are written (default: stderr)"),
+                               cl::value_desc("file"), cl::cat(Compiler));
+
+cl::OptionCategory JITCategory("JIT options");
+cl::opt<bool> Tiered("tiered", cl::desc("Compile functions quickly first and re-optimize hot ones in the background"),
+                     cl::cat(JITCategory));
+cl::opt<unsigned> TierUpThreshold("tier-up-threshold", cl::desc("Number of calls before a function is re-optimized"),
+                                  cl::value_desc("calls"), cl::init(1000), cl::cat(JITCategory));
+cl::opt<std::string> CacheDirectory("cache-dir", cl::desc("Reuse compiled code across sessions and builds from this directory"),
+                                    cl::value_desc("directory"), cl::cat(JITCategory));
+cl::opt<unsigned> CacheSizeLimit("cache-size-limit", cl::desc("Maximum size of the cache directory"),
+                                 cl::value_desc("MB"), cl::init(512), cl::cat(JITCategory));
+cl::opt<bool> UseJITLink("jitlink", cl::desc("Link JIT'd code with JITLink into slab allocated memory"),
+                         cl::cat(JITCategory));
+cl::opt<unsigned> SlabSize("slab-size", cl::desc("Size of the memory mappings used with --jitlink"),
+                           cl::value_desc("MB"), cl::init(64), cl::cat(JITCategory));
+cl::opt<bool> PrintMemoryStats("memory-stats", cl::desc("Print JIT code memory statistics at the end of the session"),
+                               cl::cat(JITCategory));
+cl::opt<unsigned> CompileThreads("threads", cl::desc("Number of threads compiling JIT'd code (0: one per core)"),
+                                  cl::init(0), cl::cat(JITCategory));
+cl::opt<bool> PerfMap("perf-map", cl::desc("Write /tmp/perf-<pid>.map for profiling JIT'd code with perf"),
+                      cl::cat(JITCategory));
+cl::opt<bool> JitDump("jitdump", cl::desc("Write a jitdump file for profiling JIT'd code with perf inject --jit"),
+                      cl::cat(JITCategory));
+cl::opt<unsigned> MemoryBudget("memory-budget",
+                               cl::desc("Evict the least recently called functions above this much JIT'd code and data"),
+                               cl::value_desc("KB"), cl::init(0), cl::cat(JITCategory));
+cl::opt<TargetLibraryInfoImpl::VectorLibrary> VectorLibrary(
+        "veclib", cl::desc("Vector math library that vectorized loops call (JIT'd at O3, object files from -O2)"),
+        cl::values(clEnumValN(TargetLibraryInfoImpl::NoLibrary, "none", "No vector library"),
+                   clEnumValN(TargetLibraryInfoImpl::Accelerate, "Accelerate", "Accelerate framework"),
+                   clEnumValN(TargetLibraryInfoImpl::DarwinLibSystemM, "Darwin_libsystem_m",
+                              "Darwin libsystem_m"),
+                   clEnumValN(TargetLibraryInfoImpl::LIBMVEC_X86, "LIBMVEC-X86", "GLIBC vector math library"),
+                   clEnumValN(TargetLibraryInfoImpl::SVML, "SVML", "Intel SVML library")),
+        cl::init(TargetLibraryInfoImpl::NoLibrary), cl::cat(JITCategory));
+
+int ReportStats(StatsFormat Format, int ExitCode) {
+    if (Format == StatsFormat::None) {
+        return ExitCode;
+    }
+
+    if (StatsFile.empty()) {
+        ReportCompileStats(Format, errs());
+        return ExitCode;
+    }
+
+    std::error_code ErrorCode;
+    raw_fd_ostream Out(StatsFile, ErrorCode, sys::fs::OF_Text);
+    if (ErrorCode) {
+        errs() << "could not open " << StatsFile << "\n";
+        return 1;
+    }
+    ReportCompileStats(Format, Out);
+    return ExitCode;
+}
 
 int main(int argc, char **argv) {
-    cl::HideUnrelatedOptions(Compiler);
+    // LLVM's own -stats (printing its statistics at exit) makes way for ours, which reports them with the rest
+    auto &RegisteredOptions = cl::getRegisteredOptions();
+    if (RegisteredOptions.count("stats")) {
+        RegisteredOptions["stats"]->setArgStr("llvm-stats");
+    }
+    cl::opt<StatsFormat> StatsOutput("stats", cl::desc("Print compile phase times, counts and LLVM's pass timers"),
+                                     cl::values(clEnumValN(StatsFormat::Text, "text", "Report for reading"),
+                                                clEnumValN(StatsFormat::JSON, "json", "JSON for tracking")),
+                                     cl::init(StatsFormat::None), cl::cat(Compiler));
+
+    cl::HideUnrelatedOptions({&Compiler, &JITCategory});
     cl::ParseCommandLineOptions(argc, argv, "The Solid Programming Language");
 
-    if (InputFile != "-" && OutputFile == "-") {
+    StatsFormat Stats = StatsOutput != StatsFormat::None ? StatsOutput.getValue()
+                        : TimeReport ? StatsFormat::Text : StatsFormat::None;
+    if (Stats != StatsFormat::None) {
+        EnableCompileStats();
+    }
+
+    if (OptLevel > 3) {
+        errs() << "optimization levels go from -O0 to -O3\n";
+        return 1;
+    }
+    OptimizationLevel Level = OptLevel == 0 ? OptimizationLevel::O0 : OptLevel == 1 ? OptimizationLevel::O1
+                              : OptLevel == 2 ? OptimizationLevel::O2 : OptimizationLevel::O3;
+
+    std::string InputFile = InputFiles.empty() ? "-" : InputFiles.front();
+
+    if (InputFile != "-" && OutputFile == "-" && !Run && InputFiles.size() == 1) {
         OutputFile = InputFile.substr(0, InputFile.find_last_of("."));
     }
 
-    if (OutputFile != "-" && OutputFile.substr(OutputFile.size() - 2) != std::string(".o")) {
-        OutputFile += ".o";
+    std::string Extension = EmitOutput == Emit::Shared ? ".so" : EmitOutput == Emit::Archive ? ".a" : ".o";
+    if (OutputFile != "-" && !StringRef(OutputFile).endswith(Extension)) {
+        OutputFile += Extension;
+    }
+
+    JITOptions Options;
+    Options.Tiered = Tiered;
+    Options.TierUpThreshold = TierUpThreshold;
+    Options.CacheDirectory = CacheDirectory;
+    Options.CacheSizeLimit = (uint64_t) CacheSizeLimit * 1024 * 1024;
+    Options.UseJITLink = UseJITLink;
+    Options.SlabSize = (uint64_t) SlabSize * 1024 * 1024;
+    Options.CompileThreads = CompileThreads;
+    Options.PerfMap = PerfMap;
+    Options.JitDump = JitDump;
+    Options.MemoryBudget = (uint64_t) MemoryBudget * 1024;
+    Options.VectorLibrary = VectorLibrary;
+
+    if (InputFiles.size() > 1) {
+        if (Run || PrintIR || ExecutionBackend == Backend::VM) {
+            errs() << "several input files can only be compiled to object files\n";
+            return 1;
+        }
+
+        if (EmitOutput != Emit::Object && OutputFile == "-") {
+            errs() << "libraries of several input files need an output file (-o)\n";
+            return 1;
+        }
+
+        return ReportStats(Stats, CompileFiles(InputFiles, OutputFile == "-" ? std::string() : OutputFile.getValue(),
+                                               Prelude, Jobs, Options, EmitOutput, Level, RuntimeDirectory));
+    }
+
+    if (!PrintTo.empty() && __solid_set_output(PrintTo.c_str()) != 0) {
+        errs() << "could not open " << PrintTo << "\n";
+        return 1;
+    }
+
+    if (PrintBinary) {
+        __solid_set_output_binary(1);
+    }
+
+    for (auto &DataFile: DataFiles) {
+        if (__solid_open_data(DataFile.c_str()) < 0) {
+            errs() << "could not read data file " << DataFile << "\n";
+            return 1;
+        }
     }
 
-    auto SolidLang = std::make_unique<class SolidLang>(InputFile, OutputFile, PrintIR);
-    return SolidLang->Start();
+    auto SolidLang = std::make_unique<class SolidLang>(InputFile, OutputFile, PrintIR, Options, PrintMemoryStats,
+                                                       Interpret, ExecutionBackend, Run, Prelude);
+    SolidLang->SetEmit(EmitOutput);
+    SolidLang->SetOptimizationLevel(Level);
+    SolidLang->SetRuntimeDirectory(RuntimeDirectory);
+    return ReportStats(Stats, SolidLang->Start());
 }
@@ -0,0 +1,24 @@
+# Builds a program with a cache directory again after changing it, only the changed functions are compiled again:
+#
+#   cmake -DSOLID_LANG=<solid_lang> -DWORK_DIRECTORY=<directory> -P IncrementalBuild.cmake
+
+file(REMOVE_RECURSE ${WORK_DIRECTORY})
+file(MAKE_DIRECTORY ${WORK_DIRECTORY})
+
+function(build SOURCE REUSED)
+    file(WRITE ${WORK_DIRECTORY}/program.solid "${SOURCE}")
+    execute_process(COMMAND ${SOLID_LANG} ${WORK_DIRECTORY}/program.solid --cache-dir=${WORK_DIRECTORY}/cache
+                            -o ${WORK_DIRECTORY}/program.o
+                    RESULT_VARIABLE Result OUTPUT_VARIABLE Output ERROR_VARIABLE Errors)
+    if (NOT Result EQUAL 0 OR NOT Output MATCHES "\\(${REUSED} functions reused\\)")
+        message(FATAL_ERROR "expected ${REUSED} functions reused:\n${Output}${Errors}")
+    endif ()
+endfunction()
+
+build("func f(x) x + 1;\nfunc g(x) f(x) * 2;\nfunc h(x) x - 3;\nh(2);\n" "0 of 4")
+# one function edited
+build("func f(x) x + 1;\nfunc g(x) f(x) * 2;\nfunc h(x) x - 4;\nh(2);\n" "3 of 4")
+# a function added, which the others don't call
+build("func k(x) x;\nfunc f(x) x + 1;\nfunc g(x) f(x) * 2;\nfunc h(x) x - 4;\nh(2);\n" "4 of 5")
+# a function removed
+build("func f(x) x + 1;\nfunc g(x) f(x) * 2;\nfunc h(x) x - 4;\nh(2);\n" "4 of 4")